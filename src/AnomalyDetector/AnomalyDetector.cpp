@@ -0,0 +1,205 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "AnomalyDetector.h"
+#include <QFile>
+
+AnomalyDetector::AnomalyDetector()
+{
+    reset();
+}
+
+void AnomalyDetector::reset()
+{
+    parser.reset();
+    log.clear();
+    for (quint64 &c : counters)
+        c = 0;
+    lastIncorrect = -2;
+    lastStatus = -1;
+    drqOffset = -1;
+}
+
+void AnomalyDetector::feed(const sniffer_item_t *items, int count, qint64 firstIndex)
+{
+    for (int i = 0; i < count; i++) {
+
+        const sniffer_item_t &item = items[i];
+        const qint64 index = firstIndex + i;
+        const sample_kind_t kind = sampleKind(item);
+
+        switch (kind) {
+        case SAMPLE_INCORRECT:
+            // Only the first sample of a sequence is reported
+            if (lastIncorrect != index - 1)
+                report(index, ANOMALY_INCORRECT_STATE);
+            lastIncorrect = index;
+            continue;
+        case SAMPLE_DATA:
+            drqOffset = -1;
+            break;
+        case SAMPLE_STATUS:
+            lastStatus = item.data & 0xff;
+            if (lastStatus & ATA_STATUS_BSY)
+                break;
+            if (lastStatus & ATA_STATUS_DRQ) {
+                if (drqOffset < 0)
+                    drqOffset = index;
+            } else if (drqOffset >= 0) {
+                // DRQ has gone without any data
+                report(drqOffset, ANOMALY_DRQ_WITHOUT_DATA);
+                drqOffset = -1;
+            }
+            break;
+        case SAMPLE_COMMAND:
+            if ((lastStatus >= 0) && (lastStatus & ATA_STATUS_BSY))
+                report(index, ANOMALY_COMMAND_WHILE_BSY, item.data & 0xff);
+            if (!knownCommands.isEmpty() && !knownCommands.testBit(item.data & 0xff))
+                report(index, ANOMALY_UNKNOWN_COMMAND, item.data & 0xff);
+            lastStatus = -1;
+            // fall through
+        case SAMPLE_TASKFILE:
+            if (drqOffset >= 0) {
+                report(drqOffset, ANOMALY_DRQ_WITHOUT_DATA);
+                drqOffset = -1;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (parser.feed(item, index))
+            checkTransaction(parser.transaction());
+    }
+}
+
+void AnomalyDetector::finish()
+{
+    // The last transaction may be cut by the capture end, so it is not checked
+    parser.finish();
+}
+
+quint64 AnomalyDetector::total() const
+{
+    quint64 n = 0;
+    for (const quint64 c : counters)
+        n += c;
+    return n;
+}
+
+bool AnomalyDetector::save(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    for (const anomaly_t &a : log)
+        file.write(QString("%1: %2\n")
+                       .arg(a.offset, 8, 16, QChar('0'))
+                       .arg(describe(a)).toUtf8());
+
+    if (total() > (quint64)log.count())
+        file.write(QString("... %1 more anomalies are not logged\n")
+                       .arg(total() - log.count()).toUtf8());
+
+    file.close();
+    return true;
+}
+
+QString AnomalyDetector::ruleName(int rule)
+{
+    switch (rule) {
+    case ANOMALY_INCORRECT_STATE:   return "INCORRECT STATE";
+    case ANOMALY_DATA_LENGTH:       return "DATA LENGTH MISMATCH";
+    case ANOMALY_COMMAND_WHILE_BSY: return "COMMAND WHILE BSY";
+    case ANOMALY_DRQ_WITHOUT_DATA:  return "DRQ WITHOUT DATA";
+    case ANOMALY_ERROR_NOT_READ:    return "ERROR NOT READ";
+    case ANOMALY_UNKNOWN_COMMAND:   return "UNKNOWN COMMAND";
+    default:                        return "UNKNOWN RULE";
+    }
+}
+
+QString AnomalyDetector::describe(const anomaly_t &a)
+{
+    switch (a.rule) {
+    case ANOMALY_DATA_LENGTH:
+        return QString("%1 (%2 of %3 bytes)")
+            .arg(ruleName(a.rule))
+            .arg(a.value * 2)
+            .arg(a.expected * 2);
+    case ANOMALY_COMMAND_WHILE_BSY:
+    case ANOMALY_ERROR_NOT_READ:
+    case ANOMALY_UNKNOWN_COMMAND:
+        return QString("%1 (0x%2)")
+            .arg(ruleName(a.rule))
+            .arg(a.value, 2, 16, QChar('0'));
+    default:
+        return ruleName(a.rule);
+    }
+}
+
+int AnomalyDetector::expectedDataWords(const transaction_t &t)
+{
+    const int count = t.sectorCount ? t.sectorCount
+                                    : (TransactionParser::isExtended(t.command) ? 65536 : 256);
+
+    switch (t.command) {
+    case 0x20: // READ SECTOR(S)
+    case 0x21: // READ SECTOR(S) without retries
+    case 0x24: // READ SECTOR(S) EXT
+    case 0x29: // READ MULTIPLE EXT
+    case 0x2f: // READ LOG EXT
+    case 0x30: // WRITE SECTOR(S)
+    case 0x31: // WRITE SECTOR(S) without retries
+    case 0x34: // WRITE SECTOR(S) EXT
+    case 0x39: // WRITE MULTIPLE EXT
+    case 0x3f: // WRITE LOG EXT
+    case 0xc4: // READ MULTIPLE
+    case 0xc5: // WRITE MULTIPLE
+        return count * 256;
+    case 0xa1: // IDENTIFY PACKET DEVICE
+    case 0xe4: // READ BUFFER
+    case 0xe8: // WRITE BUFFER
+    case 0xec: // IDENTIFY DEVICE
+        return 256;
+    case 0xb0: // S.M.A.R.T.
+        switch (t.features & 0xff) {
+        case 0xd0: // READ DATA
+        case 0xd1: // READ ATTRIBUTE THRESHOLDS
+            return 256;
+        case 0xd5: // READ LOG
+        case 0xd6: // WRITE LOG
+            return count * 256;
+        }
+        return -1;
+    default:
+        return -1; // Not a PIO data command, or unknown length
+    }
+}
+
+void AnomalyDetector::report(qint64 offset, anomaly_rule_t rule, quint32 value, quint32 expected)
+{
+    counters[rule]++;
+
+    if (log.count() < ANOMALY_MAX_LOG)
+        log.append({offset, (quint8)rule, value, expected});
+}
+
+void AnomalyDetector::checkTransaction(const transaction_t &t)
+{
+    // Commands completed with an error may transfer less data
+    if (t.status & ATA_STATUS_ERR) {
+        if (!t.errorRead)
+            report(t.offset, ANOMALY_ERROR_NOT_READ, t.command);
+        return;
+    }
+
+    const int expected = expectedDataWords(t);
+    if ((expected >= 0) && ((quint32)expected != t.dataWords))
+        report(t.offset, ANOMALY_DATA_LENGTH, t.dataWords, expected);
+}
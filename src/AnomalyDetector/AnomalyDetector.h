@@ -0,0 +1,71 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef ANOMALYDETECTOR_H
+#define ANOMALYDETECTOR_H
+
+#include <QString>
+#include <QVector>
+#include <QBitArray>
+#include "TransactionParser/TransactionParser.h"
+
+#define ANOMALY_MAX_LOG         (100000) /* Anomalies kept in the log, all are counted */
+
+#define ATA_STATUS_BSY          (0x80)
+#define ATA_STATUS_DRQ          (0x08)
+#define ATA_STATUS_ERR          (0x01)
+
+typedef enum {
+    ANOMALY_INCORRECT_STATE,    // DIOR equal to DIOW
+    ANOMALY_DATA_LENGTH,        // DATA length differs from SECTOR_COUNT x 256 words
+    ANOMALY_COMMAND_WHILE_BSY,  // COMMAND written while BSY is set
+    ANOMALY_DRQ_WITHOUT_DATA,   // DRQ asserted, but no DATA followed
+    ANOMALY_ERROR_NOT_READ,     // ERR reported, but ERROR register was not read
+    ANOMALY_UNKNOWN_COMMAND,    // Opcode is missing from the command codes list
+    ANOMALY_RULES_COUNT
+} anomaly_rule_t;
+
+typedef struct {
+    qint64 offset;      // Sample index
+    quint8 rule;
+    quint32 value;      // Rule specific: opcode, actual length...
+    quint32 expected;   // Rule specific: expected length
+} anomaly_t;
+
+// Rule engine evaluating protocol checks incrementally over the samples
+// stream. Cheap enough to run on the capture thread.
+class AnomalyDetector
+{
+public:
+    AnomalyDetector();
+    void reset();
+    void setKnownCommands(const QBitArray &commands) { knownCommands = commands; }
+    void feed(const sniffer_item_t *items, int count, qint64 firstIndex);
+    void finish();
+    const QVector<anomaly_t> &anomalies() const { return log; }
+    quint64 count(int rule) const { return counters[rule]; }
+    quint64 total() const;
+    bool save(const QString &path) const;
+    static QString ruleName(int rule);
+    static QString describe(const anomaly_t &a);
+    static int expectedDataWords(const transaction_t &t);
+
+private:
+    TransactionParser parser;
+    QBitArray knownCommands;
+    QVector<anomaly_t> log;
+    quint64 counters[ANOMALY_RULES_COUNT];
+    qint64 lastIncorrect;   // Index of the last incorrect sample
+    int lastStatus;         // Last STATUS value, or -1 if unknown
+    qint64 drqOffset;       // Index of the status read with DRQ, or -1
+
+    void report(qint64 offset, anomaly_rule_t rule, quint32 value = 0, quint32 expected = 0);
+    void checkTransaction(const transaction_t &t);
+};
+
+#endif // ANOMALYDETECTOR_H
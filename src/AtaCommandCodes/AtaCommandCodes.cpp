@@ -0,0 +1,48 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "AtaCommandCodes.h"
+#include <QFile>
+#include <QStringList>
+
+bool AtaCommandCodes::load(const QString &path, QMap<quint8, QString> *codes)
+{
+    QFile file(path);
+
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+        return false;
+
+    while (!file.atEnd()) {
+        const QString line = file.readLine();
+        const QStringList list = line.split(QChar('='));
+        if (list.length() < 2)
+            continue;
+        bool ok = false;
+        const quint8 key = list.at(0).trimmed().toUShort(&ok, 16);
+        if (!ok)
+            continue;
+        const QString value = list.at(1).trimmed();
+        if (!codes->contains(key))
+            codes->insert(key, value);
+    }
+
+    file.close();
+    return true;
+}
+
+QBitArray AtaCommandCodes::known(const QMap<quint8, QString> &codes)
+{
+    // Empty array means the list is not available
+    if (codes.isEmpty())
+        return QBitArray();
+
+    QBitArray bits(256);
+    for (auto i = codes.constBegin(); i != codes.constEnd(); ++i)
+        bits.setBit(i.key());
+    return bits;
+}
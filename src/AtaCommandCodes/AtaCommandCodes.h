@@ -0,0 +1,26 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef ATACOMMANDCODES_H
+#define ATACOMMANDCODES_H
+
+#include <QString>
+#include <QMap>
+#include <QBitArray>
+
+#define ATA_COMMAND_CODES_FILE  "AtaCommandCodes.txt"
+
+// Loader of the command codes list, one "code = name" pair per line
+class AtaCommandCodes
+{
+public:
+    static bool load(const QString &path, QMap<quint8, QString> *codes);
+    static QBitArray known(const QMap<quint8, QString> &codes);
+};
+
+#endif // ATACOMMANDCODES_H
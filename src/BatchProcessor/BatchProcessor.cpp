@@ -0,0 +1,269 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "BatchProcessor.h"
+#include "TransactionParser/TransactionParser.h"
+#include "AnomalyDetector/AnomalyDetector.h"
+#include "PayloadDecoder/PayloadDecoder.h"
+#include <QDir>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <algorithm>
+
+class BatchTask : public QRunnable
+{
+public:
+    BatchTask(BatchProcessor *processor, const QBitArray &knownCommands,
+              batch_result_t *result, volatile bool *cancel)
+        : processor(processor), knownCommands(knownCommands), result(result), cancel(cancel) {}
+
+    void run() override
+    {
+        if (*cancel) {
+            result->state = "cancelled";
+            return;
+        }
+
+        if (BatchProcessor::isUpToDate(result->path) && BatchProcessor::loadSummary(result->path, result)) {
+            result->state = "up to date";
+        } else if (BatchProcessor::processFile(result->path, knownCommands, result, cancel)) {
+            result->state = "processed";
+        } else if (*cancel) {
+            result->state = "cancelled";
+        } else {
+            result->state = "error";
+        }
+
+        emit processor->message(QString("%1: %2").arg(QFileInfo(result->path).fileName()).arg(result->state));
+    }
+
+private:
+    BatchProcessor *processor;
+    QBitArray knownCommands;
+    batch_result_t *result;
+    volatile bool *cancel;
+};
+
+BatchProcessor::BatchProcessor(QObject *parent)
+    : QObject(parent),
+    jobs(QThread::idealThreadCount()),
+    cancel(false)
+{
+
+}
+
+bool BatchProcessor::run(const QString &dir)
+{
+    cancel = false;
+
+    const QFileInfoList list = QDir(dir).entryInfoList(QStringList() << "*.sniff", QDir::Files);
+    if (list.isEmpty()) {
+        emit message(QString("No capture files found in %1").arg(dir));
+        emit finished();
+        return false;
+    }
+
+    // Largest files go first, so the longest jobs don't finish last
+    QVector<batch_result_t> results(list.count());
+    for (int i = 0; i < list.count(); i++) {
+        results[i].path = list.at(i).absoluteFilePath();
+        results[i].size = list.at(i).size();
+    }
+    std::sort(results.begin(), results.end(), [](const batch_result_t &a, const batch_result_t &b) {
+        return a.size > b.size;
+    });
+
+    emit message(QString("Batch processing of %1 files, %2 jobs...")
+                     .arg(results.count())
+                     .arg(jobs));
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, jobs));
+    for (batch_result_t &r : results)
+        pool.start(new BatchTask(this, knownCommands, &r, &cancel));
+    pool.waitForDone();
+
+    const bool ok = saveReport(dir, results);
+    emit message(ok ? QString("Batch completed, summary: %1/%2").arg(dir).arg(BATCH_SUMMARY_FILE)
+                    : QString("File writing error: %1/%2").arg(dir).arg(BATCH_SUMMARY_FILE));
+    emit finished();
+    return ok;
+}
+
+QStringList BatchProcessor::outputs(const QString &path)
+{
+    return QStringList() << path + ".index"
+                         << path + ".transactions.csv"
+                         << path + ".anomalies"
+                         << path + ".summary";
+}
+
+bool BatchProcessor::isUpToDate(const QString &path)
+{
+    const QDateTime modified = QFileInfo(path).lastModified();
+
+    for (const QString &output : outputs(path)) {
+        const QFileInfo info(output);
+        if (!info.exists() || (info.lastModified() < modified))
+            return false;
+    }
+
+    return true;
+}
+
+bool BatchProcessor::processFile(const QString &path, const QBitArray &knownCommands, batch_result_t *result,
+                                 const volatile bool *cancel)
+{
+    // Outputs are incomplete until the summary is written again
+    QFile::remove(path + ".summary");
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    QFile index(path + ".index");
+    QFile csv(path + ".transactions.csv");
+    if (!index.open(QFile::WriteOnly) || !csv.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    bool written = (csv.write("offset,command,features,sector_count,lba,device,data_bytes,status,error,status_polls\n") > 0);
+
+    result->samples = 0;
+    result->transactions = 0;
+    result->model.clear();
+    result->serial.clear();
+    result->firmware.clear();
+
+    // Transactions are written out as soon as completed, nothing is accumulated
+    auto write = [&](const transaction_t &t) {
+        const index_record_t record = { t.offset, t.dataWords, t.command, t.status, 0 };
+        written &= (index.write((const char*)&record, sizeof(record)) == sizeof(record));
+
+        written &= (csv.write(QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,")
+                                  .arg(t.offset)
+                                  .arg(t.command, 2, 16, QChar('0'))
+                                  .arg(t.features, 4, 16, QChar('0'))
+                                  .arg(t.sectorCount)
+                                  .arg(t.lba)
+                                  .arg(t.device, 2, 16, QChar('0'))
+                                  .arg(t.dataWords * 2)
+                                  .arg(t.status, 2, 16, QChar('0'))
+                                  .arg(t.errorRead ? QString("%1").arg(t.error, 2, 16, QChar('0')) : QString())
+                                  .toUtf8()) > 0);
+        written &= (csv.write(QByteArray::number(t.statusPolls).append('\n')) > 0);
+
+        if (result->model.isEmpty() && PayloadDecoder::isIdentify(t)) {
+            const identify_t id = PayloadDecoder::decodeIdentify(t.payload, t.command);
+            result->model = id.model;
+            result->serial = id.serial;
+            result->firmware = id.firmware;
+        }
+
+        result->transactions++;
+    };
+
+    TransactionParser parser;
+    AnomalyDetector detector;
+    detector.setKnownCommands(knownCommands);
+
+    QByteArray buffer(PARSER_READ_SIZE, 0);
+    qint64 br = 0;
+    while (written && !(cancel && *cancel)
+           && ((br = file.read(buffer.data(), buffer.size())) >= (qint64)sizeof(sniffer_item_t))) {
+        const sniffer_item_t *items = (const sniffer_item_t*)buffer.constData();
+        const int count = br / sizeof(sniffer_item_t);
+
+        detector.feed(items, count, result->samples);
+        for (int i = 0; i < count; i++) {
+            if (parser.feed(items[i], result->samples + i))
+                write(parser.transaction());
+        }
+
+        result->samples += count;
+    }
+
+    if (cancel && *cancel)
+        return false;
+
+    if (parser.finish())
+        write(parser.transaction());
+    detector.finish();
+
+    file.close();
+    index.close();
+    csv.close();
+
+    // Buffered data is flushed on close, so errors are checked after it
+    if (!written || (br < 0) || (index.error() != QFile::NoError) || (csv.error() != QFile::NoError))
+        return false;
+
+    result->anomalies = detector.total();
+    if (!detector.save(path + ".anomalies"))
+        return false;
+
+    // Summary is written last, it marks the outputs as complete
+    QSettings summary(path + ".summary", QSettings::IniFormat);
+    summary.setValue("samples", result->samples);
+    summary.setValue("transactions", result->transactions);
+    summary.setValue("anomalies", result->anomalies);
+    summary.setValue("model", result->model);
+    summary.setValue("serial", result->serial);
+    summary.setValue("firmware", result->firmware);
+    summary.sync();
+
+    return (summary.status() == QSettings::NoError);
+}
+
+bool BatchProcessor::loadSummary(const QString &path, batch_result_t *result)
+{
+    QSettings summary(path + ".summary", QSettings::IniFormat);
+    if (!summary.contains("samples"))
+        return false;
+
+    result->samples = summary.value("samples").toLongLong();
+    result->transactions = summary.value("transactions").toLongLong();
+    result->anomalies = summary.value("anomalies").toULongLong();
+    result->model = summary.value("model").toString();
+    result->serial = summary.value("serial").toString();
+    result->firmware = summary.value("firmware").toString();
+    return true;
+}
+
+bool BatchProcessor::saveReport(const QString &dir, const QVector<batch_result_t> &results)
+{
+    QFile file(QString("%1/%2").arg(dir).arg(BATCH_SUMMARY_FILE));
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    // Quotes are doubled in CSV fields
+    auto quoted = [](QString s) {
+        return QString("\"%1\"").arg(s.replace('"', "\"\""));
+    };
+
+    file.write("file,size,samples,transactions,anomalies,model,serial,firmware,state\n");
+    for (const batch_result_t &r : results)
+        file.write(QString("%1,%2,%3,%4,%5,%6,%7,%8,%9\n")
+                       .arg(quoted(QFileInfo(r.path).fileName()))
+                       .arg(r.size)
+                       .arg(r.samples)
+                       .arg(r.transactions)
+                       .arg(r.anomalies)
+                       .arg(quoted(r.model))
+                       .arg(quoted(r.serial))
+                       .arg(quoted(r.firmware))
+                       .arg(r.state)
+                       .toUtf8());
+
+    file.close();
+    return true;
+}
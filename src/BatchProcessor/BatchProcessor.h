@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QObject>
+#include <QBitArray>
+#include <QVector>
+
+#define BATCH_SUMMARY_FILE      "batch-summary.csv"
+
+#pragma pack(push, 1)
+
+// Record of the '.index' file, one per transaction
+typedef struct {
+    qint64 offset;          // Sample index of COMMAND register write
+    quint32 dataWords;
+    quint8 command;
+    quint8 status;
+    quint16 reserved;
+} index_record_t;
+
+static_assert(sizeof(index_record_t) == 16, "Incorrect 'index_record_t' size!");
+
+#pragma pack(pop)
+
+typedef struct {
+    QString path;
+    qint64 size;
+    qint64 samples;
+    qint64 transactions;
+    quint64 anomalies;
+    QString model;          // Drive identity from the first IDENTIFY DEVICE
+    QString serial;
+    QString firmware;
+    QString state;
+} batch_result_t;
+
+// Processes all the capture files of a directory on a thread pool: builds the
+// transactions index, exports transactions to CSV and runs anomaly checks.
+// Every worker streams its file with a fixed size buffer.
+class BatchProcessor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BatchProcessor(QObject *parent = nullptr);
+    void setJobs(int jobs) { this->jobs = jobs; }
+    void setKnownCommands(const QBitArray &commands) { knownCommands = commands; }
+    static bool isUpToDate(const QString &path);
+    static bool processFile(const QString &path, const QBitArray &knownCommands, batch_result_t *result,
+                            const volatile bool *cancel = nullptr);
+    static bool loadSummary(const QString &path, batch_result_t *result);
+
+public slots:
+    bool run(const QString &dir);
+    void stop() { cancel = true; }
+
+signals:
+    void message(const QString &s);
+    void finished();
+
+private:
+    int jobs;
+    QBitArray knownCommands;
+    volatile bool cancel;
+    static QStringList outputs(const QString &path);
+    bool saveReport(const QString &dir, const QVector<batch_result_t> &results);
+};
+
+#endif // BATCHPROCESSOR_H
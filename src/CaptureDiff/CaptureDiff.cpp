@@ -0,0 +1,205 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "CaptureDiff.h"
+#include <QHash>
+#include <QStack>
+#include <algorithm>
+
+CaptureDiff::CaptureDiff()
+    : matchedCount(0)
+{
+
+}
+
+bool CaptureDiff::compare(const QString &firstPath, const QString &secondPath)
+{
+    a.clear();
+    b.clear();
+    keysA.clear();
+    keysB.clear();
+    diff.clear();
+    matchedCount = 0;
+
+    if (!load(firstPath, &a, &keysA)) {
+        error = QString("File reading error: %1").arg(firstPath);
+        return false;
+    }
+
+    if (!load(secondPath, &b, &keysB)) {
+        error = QString("File reading error: %1").arg(secondPath);
+        return false;
+    }
+
+    const QVector<QPair<int, int>> pairs = align();
+    matchedCount = pairs.count();
+
+    // Unmatched transactions between the matched ones are the differences
+    int lastA = 0;
+    int lastB = 0;
+    for (const QPair<int, int> &p : pairs) {
+        appendGap(lastA, p.first, lastB, p.second);
+        lastA = p.first + 1;
+        lastB = p.second + 1;
+    }
+    appendGap(lastA, a.count(), lastB, b.count());
+
+    return true;
+}
+
+quint64 CaptureDiff::key(const transaction_t &t)
+{
+    // Offsets and status polls count are not a part of the key
+    quint64 h = t.payloadHash;
+    const quint64 fields[] = {
+        t.command,
+        t.features,
+        t.sectorCount,
+        t.lba,
+        t.device,
+        t.dataWords,
+        (quint64)t.status | ((quint64)t.error << 8) | ((quint64)t.errorRead << 16)
+    };
+
+    for (const quint64 f : fields)
+        h = (h ^ f) * 0x00000100000001b3ULL;
+
+    return h;
+}
+
+bool CaptureDiff::load(const QString &path, QVector<transaction_t> *list, QVector<quint64> *keys)
+{
+    return TransactionParser::parseFile(path, [list, keys](const transaction_t &t) {
+        list->append(t);
+        keys->append(key(t));
+    });
+}
+
+QVector<QPair<int, int>> CaptureDiff::align() const
+{
+    QVector<QPair<int, int>> pairs;
+
+    // Ranges are processed iteratively, as deep recursion is possible on large traces
+    struct range_t { int a0, a1, b0, b1; };
+    QStack<range_t> stack;
+    stack.push({0, int(a.count()), 0, int(b.count())});
+
+    while (!stack.isEmpty()) {
+        range_t r = stack.pop();
+
+        // Common head and tail
+        while ((r.a0 < r.a1) && (r.b0 < r.b1) && (keysA.at(r.a0) == keysB.at(r.b0)))
+            pairs.append(qMakePair(r.a0++, r.b0++));
+        while ((r.a0 < r.a1) && (r.b0 < r.b1) && (keysA.at(r.a1 - 1) == keysB.at(r.b1 - 1)))
+            pairs.append(qMakePair(--r.a1, --r.b1));
+
+        if ((r.a0 == r.a1) || (r.b0 == r.b1))
+            continue;
+
+        const QVector<QPair<int, int>> list = anchors(r.a0, r.a1, r.b0, r.b1);
+        if (list.isEmpty())
+            continue;
+
+        // Gaps between anchors are aligned the same way
+        int a0 = r.a0;
+        int b0 = r.b0;
+        for (const QPair<int, int> &p : list) {
+            stack.push({a0, p.first, b0, p.second});
+            pairs.append(p);
+            a0 = p.first + 1;
+            b0 = p.second + 1;
+        }
+        stack.push({a0, r.a1, b0, r.b1});
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+QVector<QPair<int, int>> CaptureDiff::anchors(int a0, int a1, int b0, int b1) const
+{
+    // Keys occurring exactly once in both ranges
+    QHash<quint64, int> uniqueA;
+    for (int i = a0; i < a1; i++) {
+        auto it = uniqueA.find(keysA.at(i));
+        if (it == uniqueA.end())
+            uniqueA.insert(keysA.at(i), i);
+        else
+            it.value() = -1;
+    }
+
+    QHash<quint64, int> uniqueB;
+    for (int i = b0; i < b1; i++) {
+        if (!uniqueA.contains(keysB.at(i)))
+            continue;
+        auto it = uniqueB.find(keysB.at(i));
+        if (it == uniqueB.end())
+            uniqueB.insert(keysB.at(i), i);
+        else
+            it.value() = -1;
+    }
+
+    QVector<QPair<int, int>> common;
+    for (int i = a0; i < a1; i++) {
+        const int ia = uniqueA.value(keysA.at(i), -1);
+        const int ib = uniqueB.value(keysA.at(i), -1);
+        if ((ia == i) && (ib >= 0))
+            common.append(qMakePair(i, ib));
+    }
+
+    if (common.isEmpty())
+        return common;
+
+    // Longest increasing subsequence of the second indexes
+    QVector<int> tails;     // Index in 'common' of the smallest tail for every length
+    QVector<int> previous(common.count(), -1);
+    for (int i = 0; i < common.count(); i++) {
+        auto pos = std::lower_bound(tails.begin(), tails.end(), common.at(i).second,
+                                    [&common](int t, int value) { return common.at(t).second < value; });
+        const int n = pos - tails.begin();
+        if (n > 0)
+            previous[i] = tails.at(n - 1);
+        if (n == tails.count())
+            tails.append(i);
+        else
+            tails[n] = i;
+    }
+
+    QVector<QPair<int, int>> result(tails.count());
+    for (int i = tails.last(), n = tails.count() - 1; i >= 0; i = previous.at(i), n--)
+        result[n] = common.at(i);
+
+    return result;
+}
+
+void CaptureDiff::appendGap(int a0, int a1, int b0, int b1)
+{
+    // Transactions in the same gap position with the same command and
+    // address are reported as changed, the rest as removed or added.
+    // The longer side of the gap is consumed first to keep it aligned.
+    while ((a0 < a1) && (b0 < b1)) {
+        const transaction_t &ta = a.at(a0);
+        const transaction_t &tb = b.at(b0);
+        if ((ta.command == tb.command) && (ta.lba == tb.lba) && (ta.sectorCount == tb.sectorCount)) {
+            diff.append({DIFF_CHANGED, a0++, b0++});
+        } else if ((a1 - a0) > (b1 - b0)) {
+            diff.append({DIFF_REMOVED, a0++, -1});
+        } else if ((a1 - a0) < (b1 - b0)) {
+            diff.append({DIFF_ADDED, -1, b0++});
+        } else {
+            diff.append({DIFF_REMOVED, a0++, -1});
+            diff.append({DIFF_ADDED, -1, b0++});
+        }
+    }
+
+    while (a0 < a1)
+        diff.append({DIFF_REMOVED, a0++, -1});
+
+    while (b0 < b1)
+        diff.append({DIFF_ADDED, -1, b0++});
+}
@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef CAPTUREDIFF_H
+#define CAPTUREDIFF_H
+
+#include <QString>
+#include <QVector>
+#include <QPair>
+#include "TransactionParser/TransactionParser.h"
+
+typedef enum {
+    DIFF_CHANGED,   // Same command and address, different data or result
+    DIFF_REMOVED,   // Present in the first capture only
+    DIFF_ADDED      // Present in the second capture only
+} diff_kind_t;
+
+typedef struct {
+    diff_kind_t kind;
+    int first;      // Transaction index in the first capture, or -1
+    int second;     // Transaction index in the second capture, or -1
+} diff_entry_t;
+
+// Transaction level comparison of two captures. Transactions are hashed
+// (status polls count excluded) and aligned by unique common hashes, like
+// patience diff does, so the cost stays close to linear for large traces.
+class CaptureDiff
+{
+public:
+    CaptureDiff();
+    bool compare(const QString &firstPath, const QString &secondPath);
+    const QVector<transaction_t> &first() const { return a; }
+    const QVector<transaction_t> &second() const { return b; }
+    const QVector<diff_entry_t> &differences() const { return diff; }
+    int matched() const { return matchedCount; }
+    QString errorString() const { return error; }
+    static quint64 key(const transaction_t &t);
+
+private:
+    QVector<transaction_t> a;
+    QVector<transaction_t> b;
+    QVector<quint64> keysA;
+    QVector<quint64> keysB;
+    QVector<diff_entry_t> diff;
+    int matchedCount;
+    QString error;
+
+    static bool load(const QString &path, QVector<transaction_t> *list, QVector<quint64> *keys);
+    QVector<QPair<int, int>> align() const;
+    QVector<QPair<int, int>> anchors(int a0, int a1, int b0, int b1) const;
+    void appendGap(int a0, int a1, int b0, int b1);
+};
+
+#endif // CAPTUREDIFF_H
@@ -0,0 +1,235 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "CaptureWriter.h"
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#endif
+
+#ifdef Q_OS_LINUX
+
+CaptureWriter::CaptureWriter()
+    : total(0),
+    fd(-1),
+    direct(false),
+    buffer(nullptr),
+    used(0),
+    flushed(0),
+    reserved(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const QString &path, bool direct)
+{
+    close();
+
+    total = 0;
+    used = 0;
+    flushed = 0;
+    reserved = 0;
+    error.clear();
+
+    void *p = nullptr;
+    if (posix_memalign(&p, WRITER_ALIGNMENT, WRITER_BUFFER_SIZE) != 0) {
+        error = "Out of memory";
+        return false;
+    }
+    buffer = (char*)p;
+
+    // Some file systems (tmpfs, network shares) refuse O_DIRECT,
+    // buffered writes with explicit writeback are used there
+    const QByteArray name = QFile::encodeName(path);
+    fd = -1;
+    if (direct)
+        fd = ::open(name.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+    this->direct = (fd >= 0);
+    if (fd < 0)
+        fd = ::open(name.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        setError();
+        free(buffer);
+        buffer = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+bool CaptureWriter::write(const char *data, qint64 length)
+{
+    if (fd < 0)
+        return false;
+
+    while (length > 0) {
+        const qint64 part = qMin(length, WRITER_BUFFER_SIZE - used);
+        memcpy(buffer + used, data, part);
+        used += part;
+        total += part;
+        data += part;
+        length -= part;
+
+        if ((used == WRITER_BUFFER_SIZE) && !flush(used))
+            return false;
+    }
+
+    return true;
+}
+
+bool CaptureWriter::close()
+{
+    if (fd < 0)
+        return error.isEmpty();
+
+    bool ok = error.isEmpty();
+
+    // The tail is padded up to the alignment, the file is cut to its real size later
+    if (ok && (used > 0)) {
+        const qint64 length = (used + WRITER_ALIGNMENT - 1) & ~qint64(WRITER_ALIGNMENT - 1);
+        memset(buffer + used, 0, length - used);
+        ok = flush(length);
+    }
+
+    // Releases the preallocated space beyond the end of data as well
+    if (ftruncate(fd, total) != 0) {
+        if (ok)
+            setError();
+        ok = false;
+    }
+
+    // The size change made by truncation must reach the disk in both modes
+    if (fdatasync(fd) != 0) {
+        if (ok)
+            setError();
+        ok = false;
+    }
+
+    if (!direct)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    if ((::close(fd) != 0) && ok) {
+        setError();
+        ok = false;
+    }
+
+    fd = -1;
+    free(buffer);
+    buffer = nullptr;
+    return ok;
+}
+
+bool CaptureWriter::flush(qint64 length)
+{
+    // Extents are allocated by big chunks, so a long capture neither
+    // stalls on block allocation nor ends up fragmented
+    if (flushed + length > reserved) {
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, reserved, WRITER_PREALLOC_SIZE) == 0)
+            reserved += WRITER_PREALLOC_SIZE;
+        else
+            reserved = flushed + length; // Not supported, keep going without it
+    }
+
+    qint64 done = 0;
+    while (done < length) {
+        const ssize_t n = pwrite(fd, buffer + done, length - done, flushed + done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            setError();
+            return false;
+        }
+        done += n;
+    }
+
+    // Buffered mode: writeback of this block is started at once, the previous
+    // block is waited for and dropped, so the page cache does not grow
+    if (!direct) {
+        sync_file_range(fd, flushed, length, SYNC_FILE_RANGE_WRITE);
+        if (flushed > 0) {
+            const qint64 previous = qMax<qint64>(0, flushed - WRITER_BUFFER_SIZE);
+            sync_file_range(fd, previous, flushed - previous,
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(fd, previous, flushed - previous, POSIX_FADV_DONTNEED);
+        }
+    }
+
+    flushed += length;
+    used = 0;
+    return true;
+}
+
+void CaptureWriter::setError()
+{
+    error = QString::fromLocal8Bit(strerror(errno));
+}
+
+#else
+
+CaptureWriter::CaptureWriter()
+    : total(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const QString &path, bool direct)
+{
+    Q_UNUSED(direct);
+    close();
+
+    total = 0;
+    error.clear();
+    file.setFileName(path);
+
+    if (!file.open(QFile::WriteOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool CaptureWriter::write(const char *data, qint64 length)
+{
+    if (file.write(data, length) != length) {
+        error = file.errorString();
+        return false;
+    }
+
+    total += length;
+    return true;
+}
+
+bool CaptureWriter::close()
+{
+    if (!file.isOpen())
+        return error.isEmpty();
+
+    file.close();
+    if (file.error() != QFile::NoError) {
+        error = file.errorString();
+        return false;
+    }
+
+    return error.isEmpty();
+}
+
+#endif
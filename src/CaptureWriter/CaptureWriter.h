@@ -0,0 +1,51 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <QString>
+#include <QFile>
+
+#define WRITER_ALIGNMENT        (4096)              /* O_DIRECT offset, length and memory alignment */
+#define WRITER_BUFFER_SIZE      (4 * 1024 * 1024)   /* Staging buffer, multiple of the alignment */
+#define WRITER_PREALLOC_SIZE    (256 * 1024 * 1024) /* Disk space reserved ahead of the write position */
+
+// Sequential capture file writer. On Linux the file is preallocated and written
+// by large blocks with early writeback, so the page cache does not grow. O_DIRECT
+// is optional: its writes are synchronous and stall the capture thread on slow
+// disks. Other systems use QFile.
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+    bool open(const QString &path, bool direct = false);
+    bool write(const char *data, qint64 length);
+    bool close();
+    qint64 size() const { return total; }
+    QString errorString() const { return error; }
+
+private:
+    qint64 total;   // Bytes accepted
+    QString error;
+#ifdef Q_OS_LINUX
+    int fd;
+    bool direct;    // O_DIRECT is requested and supported by the file system
+    char *buffer;
+    qint64 used;    // Bytes in the staging buffer
+    qint64 flushed; // Bytes passed to the kernel
+    qint64 reserved;
+    bool flush(qint64 length);
+    void setError();
+#else
+    QFile file;
+#endif
+};
+
+#endif // CAPTUREWRITER_H
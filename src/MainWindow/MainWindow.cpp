@@ -9,14 +9,47 @@
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
 #include "AtaRegisters.h"
+#include "CaptureDiff/CaptureDiff.h"
+#include "AnomalyDetector/AnomalyDetector.h"
+#include "PayloadDecoder/PayloadDecoder.h"
+#include "AtaCommandCodes/AtaCommandCodes.h"
+#include "Profiler/Profiler.h"
 #include <QStandardPaths>
 #include <QFileDialog>
 #include <QDateTime>
 #include <QMessageBox>
+#include <QSettings>
+#include <QSysInfo>
+#include <QFileInfo>
+#include <QMouseEvent>
+#include <QTextBlock>
+
+// Clock divider sets FX3 PIB frequency as (384.0 MHz / clkDiv)
+// The minimum value is 2, the maximum is 1024
+typedef struct {
+    const char *name;
+    quint16 clkDiv;     // Default value
+    quint16 clkDivMin;  // Best values range
+    quint16 clkDivMax;
+} pio_mode_t;
+
+static const pio_mode_t pioModes[] = {
+    { "PIO0 (600 ns)", 24, 6, 40 },
+    { "PIO1 (383 ns)", 18, 6, 30 },
+    { "PIO2 (240 ns)", 12, 6, 18 },
+    { "PIO3 (180 ns)", 10, 6, 14 },
+    { "PIO4 (120 ns)",  8, 6,  9 }
+};
+
+// Decoder profiler stages
+enum { DECODE_READ, DECODE_PARSE, DECODE_BURST, DECODE_TEXT };
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , running(0)
+    , tuningMode(0)
+    , tunedClkDiv(0)
 {
     ui->setupUi(this);
 
@@ -24,23 +57,50 @@ MainWindow::MainWindow(QWidget *parent)
 
     ui->startButton->setEnabled(false);
     ui->stopButton->setEnabled(false);
+    ui->tuneButton->setEnabled(false);
+
+    // Every attached sniffer has its own thread and capture pipeline
+    const int count = qMax(1, UsbSniffer::deviceCount());
+    for (int i = 0; i < count; i++) {
+        QThread *thread = new QThread(this);
+        UsbSniffer *sniffer = new UsbSniffer(i);
+        sniffer->moveToThread(thread);
+
+        connect(sniffer, &UsbSniffer::message, this, [this, i](const QString &s) { deviceMessage(i, s); });
+        connect(sniffer, &UsbSniffer::initialized, this, [this, i]() { deviceInitialized(i); });
+        connect(sniffer, &UsbSniffer::lockInterface, this, &MainWindow::deviceStarted);
+        connect(sniffer, &UsbSniffer::unlockInterface, this, &MainWindow::deviceStopped);
+        connect(sniffer, &UsbSniffer::updateStatistics, this, [this, i](const statistics_t &st) { updateStatistics(i, st); });
+        connect(sniffer, &UsbSniffer::tuned, this, [this, i](int clkDiv, int transferSize) { tuned(i, clkDiv, transferSize); });
+        connect(ui->stopButton, &QPushButton::pressed, sniffer, &UsbSniffer::stop, Qt::DirectConnection);
+        connect(thread, &QThread::started, sniffer, &UsbSniffer::init);
+        connect(thread, &QThread::finished, sniffer, &UsbSniffer::deleteLater);
+
+        threads.append(thread);
+        sniffers.append(sniffer);
+        ready.append(false);
+    }
 
-    thread = new QThread(this);
-    sniffer = new UsbSniffer;
-    sniffer->moveToThread(thread);
-
-    connect(sniffer, &UsbSniffer::message, this, &MainWindow::message);
-    connect(sniffer, &UsbSniffer::lockInterface, this, &MainWindow::lockInterface);
-    connect(sniffer, &UsbSniffer::unlockInterface, this, &MainWindow::unlockInterface);
-    connect(sniffer, &UsbSniffer::updateStatistics, this, &MainWindow::updateStatistics);
     connect(ui->findButton, &QPushButton::pressed, this, &MainWindow::findLocation);
     connect(ui->startButton, &QPushButton::pressed, this, &MainWindow::startPressed);
-    connect(ui->stopButton, &QPushButton::pressed, sniffer, &UsbSniffer::stop, Qt::DirectConnection);
+    connect(ui->tuneButton, &QPushButton::pressed, this, &MainWindow::tunePressed);
     connect(ui->decoderButton, &QPushButton::pressed, this, &MainWindow::decodePressed);
     connect(ui->exportButton, &QPushButton::pressed, this, &MainWindow::exportPressed);
-    connect(this, &MainWindow::start, sniffer, &UsbSniffer::start);
-    connect(thread, &QThread::started, sniffer, &UsbSniffer::init);
-    connect(thread, &QThread::finished, sniffer, &UsbSniffer::deleteLater);
+    connect(ui->diffButton, &QPushButton::pressed, this, &MainWindow::diffPressed);
+    connect(ui->anomaliesButton, &QPushButton::pressed, this, &MainWindow::anomaliesPressed);
+    batchThread = new QThread(this);
+    processor = new BatchProcessor;
+    processor->moveToThread(batchThread);
+
+    connect(processor, &BatchProcessor::message, this, &MainWindow::message);
+    connect(processor, &BatchProcessor::finished, this, [this]() { ui->actionBatch->setEnabled(true); });
+    connect(this, &MainWindow::batch, processor, &BatchProcessor::run);
+    connect(batchThread, &QThread::finished, processor, &BatchProcessor::deleteLater);
+    connect(ui->actionBatch, &QAction::triggered, this, &MainWindow::batchTriggered);
+    connect(ui->actionProfiling, &QAction::toggled, this, [this](bool checked) {
+        for (UsbSniffer *sniffer : sniffers)
+            sniffer->setProfiling(checked);
+    });
     connect(ui->actionExit, &QAction::triggered, this, &MainWindow::close);
     connect(ui->actionAbout, &QAction::triggered, this, &MainWindow::about);
 
@@ -49,23 +109,38 @@ MainWindow::MainWindow(QWidget *parent)
 
     const QFont mono = QFont("Consolas", 9);
     ui->decoderTextEdit->setFont(mono);
+    ui->decoderTextEdit->viewport()->installEventFilter(this);
+    hexCache.setMaxCost(HEX_CACHE_LINES);
 
-    const QStringList list = QStringList() << "PIO0 (600 ns)" << "PIO1 (383 ns)" << "PIO2 (240 ns)" << "PIO3 (180 ns)" << "PIO4 (120 ns)";
-    ui->comboBox->addItems(list);
-    ui->comboBox->setCurrentIndex(list.size() - 1);
+    for (const pio_mode_t &mode : pioModes)
+        ui->comboBox->addItem(mode.name);
+    ui->comboBox->setCurrentIndex(ui->comboBox->count() - 1);
     ui->comboBox->setEnabled(false);
 
     loadAtaCommandCodes();
 
-    thread->start();
+    for (UsbSniffer *sniffer : sniffers)
+        sniffer->setKnownCommands(knownCommands());
+    processor->setKnownCommands(knownCommands());
+
+    for (QThread *thread : threads)
+        thread->start();
+    batchThread->start();
 }
 
 MainWindow::~MainWindow()
 {
-    sniffer->stop();
+    for (UsbSniffer *sniffer : sniffers)
+        sniffer->stop();
 
-    thread->exit();
-    thread->wait();
+    for (QThread *thread : threads) {
+        thread->exit();
+        thread->wait();
+    }
+
+    processor->stop();
+    batchThread->exit();
+    batchThread->wait();
 
     delete ui;
 }
@@ -75,11 +150,39 @@ void MainWindow::message(const QString &s)
     ui->reportTextEdit->appendPlainText(s);
 }
 
+void MainWindow::deviceMessage(int device, const QString &s)
+{
+    if (sniffers.count() > 1)
+        message(QString("[#%1] %2").arg(device + 1).arg(s));
+    else
+        message(s);
+}
+
+void MainWindow::deviceInitialized(int device)
+{
+    ready[device] = true;
+    if (running == 0)
+        unlockInterface();
+}
+
+void MainWindow::deviceStarted()
+{
+    lockInterface();
+}
+
+void MainWindow::deviceStopped()
+{
+    // Interface is unlocked when all the started devices are stopped
+    if ((running > 0) && (--running == 0))
+        unlockInterface();
+}
+
 void MainWindow::lockInterface()
 {
     ui->comboBox->setEnabled(false);
     ui->startButton->setEnabled(false);
     ui->stopButton->setEnabled(true);
+    ui->tuneButton->setEnabled(false);
 }
 
 void MainWindow::unlockInterface()
@@ -87,6 +190,7 @@ void MainWindow::unlockInterface()
     ui->comboBox->setEnabled(true);
     ui->startButton->setEnabled(true);
     ui->stopButton->setEnabled(false);
+    ui->tuneButton->setEnabled(true);
 }
 
 void MainWindow::findLocation()
@@ -102,36 +206,86 @@ void MainWindow::findLocation()
 void MainWindow::startPressed()
 {
     const QDateTime dt = QDateTime::currentDateTime();
-    const QString path = QString("%1/capturing-%2.sniff")
-                             .arg(ui->locationEdit->text())
-                             .arg(dt.toString("yyyy.MM.dd-hh.mm.ss"));
-
-    // Clock divider sets FX3 PIB frequency as (384.0 MHz / clkDiv)
-    // The minimum value is 2, the maximum is 1024
-    quint16 clkDiv;
-    switch (ui->comboBox->currentIndex()) {
-    case 0:
-        // PIO mode 0, best values are 6...40,
-        clkDiv = 24;
-        break;
-    case 1:
-        // PIO mode 1, best values are 6...30
-        clkDiv = 18;
-        break;
-    case 2:
-        // PIO mode 2, best values are 6...18
-        clkDiv = 12;
-        break;
-    case 3:
-        // PIO mode 3, best values are 6...14
-        clkDiv = 10;
-        break;
-    default:
-        // PIO mode 4, best values are 6...9
-        clkDiv = 8;
+
+    const int index = ui->comboBox->currentIndex();
+    int clkDiv = pioModes[index].clkDiv;
+
+    // Use auto-tuned values if any
+    QSettings settings;
+    settings.beginGroup(tuningGroup(index));
+    if (settings.contains("clkDiv")) {
+        clkDiv = settings.value("clkDiv").toInt();
+        message(QString("Using auto-tuned clkDiv %1.").arg(clkDiv));
+    }
+
+    // All the devices share the same file name timestamp and the same epoch
+    statistics.clear();
+    lockInterface();
+    running = ready.count(true);
+    const qint64 epoch = UsbSniffer::timestamp();
+    for (int i = 0; i < sniffers.count(); i++) {
+        if (!ready.at(i))
+            continue;
+
+        const QString key = QString("device%1/transferSize").arg(i);
+        const int transferSize = settings.value(key, DEFAULT_BUFFER_SIZE).toInt();
+        if (settings.contains(key))
+            deviceMessage(i, QString("Using auto-tuned transfer %1 KiB.").arg(transferSize / 1024));
+
+        QString path = QString("%1/capturing-%2")
+                           .arg(ui->locationEdit->text())
+                           .arg(dt.toString("yyyy.MM.dd-hh.mm.ss"));
+        if (sniffers.count() > 1)
+            path.append(QString("-dev%1").arg(i + 1));
+        path.append(".sniff");
+
+        UsbSniffer *sniffer = sniffers.at(i);
+        QMetaObject::invokeMethod(sniffer, [=]() {
+            sniffer->start(path, clkDiv, transferSize, epoch);
+        }, Qt::QueuedConnection);
     }
+    settings.endGroup();
+}
 
-    emit start(path, clkDiv);
+void MainWindow::tunePressed()
+{
+    const pio_mode_t &mode = pioModes[ui->comboBox->currentIndex()];
+    tuningMode = ui->comboBox->currentIndex();
+    tunedClkDiv = 0;
+
+    lockInterface();
+    running = ready.count(true);
+    for (int i = 0; i < sniffers.count(); i++) {
+        if (!ready.at(i))
+            continue;
+
+        UsbSniffer *sniffer = sniffers.at(i);
+        QMetaObject::invokeMethod(sniffer, [=]() {
+            sniffer->tune(mode.clkDivMin, mode.clkDivMax);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void MainWindow::tuned(int device, int clkDiv, int transferSize)
+{
+    // All the devices are started with one clock divider, so the largest
+    // (safest) one is kept. Transfer size is tuned for every device
+    // separately and stored by its index, stable while the cabling is the same.
+    tunedClkDiv = qMax(tunedClkDiv, clkDiv);
+
+    // Tuned values are stored per host and per PIO mode
+    QSettings settings;
+    settings.beginGroup(tuningGroup(tuningMode));
+    settings.setValue("clkDiv", tunedClkDiv);
+    settings.setValue(QString("device%1/transferSize").arg(device), transferSize);
+    settings.endGroup();
+}
+
+QString MainWindow::tuningGroup(int pioMode)
+{
+    return QString("tuning/%1/pio%2")
+        .arg(QSysInfo::machineHostName())
+        .arg(pioMode);
 }
 
 void MainWindow::decodePressed()
@@ -144,6 +298,12 @@ void MainWindow::decodePressed()
         return;
 
     ui->decoderTextEdit->clear();
+    ui->timelineWidget->clear();
+    bursts.clear();
+    hexCache.clear();
+    expandedLines.clear();
+    payloads.clear();
+    decodedPath = path;
 
     QTextCharFormat tf = ui->decoderTextEdit->currentCharFormat();
 
@@ -157,19 +317,30 @@ void MainWindow::decodePressed()
         return;
     }
 
+    ui->timelineWidget->load(path);
+
     qint64 dataStart = -1; // Data flow beginning
-    bool dataRead = true; // Data flow direction
+    data_burst_t burst = {};
+    TransactionParser parser;
+    QVector<quint16> head; // First words of the data flow, used for content hints
+    quint8 lastCommand = 0;
     int lastAltStatusSample = -1; // Used to hide duplicate values of ALT_STATUS
     quint16 lastAltStatusValue = 0;
     int lastStatusSample = -1; // Used to hide duplicate values of STATUS
     quint16 lastStatusValue = 0;
     const int samplesCount = file.size() / sizeof(sniffer_item_t);
 
+    Profiler profiler({"read", "parse", "burst", "text"});
+    profiler.reset(ui->actionProfiling->isChecked(), true);
+
     for (int i = 0; i < samplesCount; i++) {
 
         // RAW data item
         sniffer_item_t item;
-        if (file.read((char*)&item, sizeof(item)) != sizeof(item)) {
+        const qint64 t = profiler.begin();
+        const qint64 bytesRead = file.read((char*)&item, sizeof(item));
+        profiler.end(DECODE_READ, t);
+        if (bytesRead != sizeof(item)) {
             tf.setForeground(QBrush(QColor(Qt::black)));
             ui->decoderTextEdit->setCurrentCharFormat(tf);
             ui->decoderTextEdit->appendPlainText("File reading error!");
@@ -256,40 +427,47 @@ void MainWindow::decodePressed()
 
         // Data begins
         if ((item.address == (ATA_REG_DATA)) && (dataStart == -1)) {
-            dataRead = read;
             dataStart = i;
+            burst = {i, 0, read, 0, lastCommand, true, true};
+            head.clear();
         }
 
+        // Data summary is collected on the fly, hex dump is formatted on demand only
+        if (item.address == (ATA_REG_DATA)) {
+            burst.checksum += item.data;
+            burst.zeros &= (item.data == 0x0000);
+            burst.ones &= (item.data == 0xffff);
+            if (head.count() < BURST_HEAD_WORDS)
+                head.append(item.data);
+        }
+
+        if ((item.address == (ATA_REG_STATUS)) && !read)
+            lastCommand = item.data & 0xff;
+
         // Data ended
         if ((item.address != (ATA_REG_DATA)) && (dataStart != -1)) {
-            const QColor c = dataRead ? Qt::blue : Qt::red;
-            tf.setForeground(QBrush(c));
-            ui->decoderTextEdit->setCurrentCharFormat(tf);
-            ui->decoderTextEdit->appendPlainText(QString("%1: [....] %2 PIO data %3 (%4 bytes)")
-                                                     .arg(dataStart, 8, 16, QChar('0'))
-                                                     .arg(dataRead ? "<<" : ">>")
-                                                     .arg(dataRead ? "read" : "write")
-                                                     .arg((i - dataStart) * 2));
-            printHexData(&file, dataStart, i - dataStart);
-            file.seek((i + 1) * sizeof(sniffer_item_t));
+            ProfilerScope scope(&profiler, DECODE_BURST);
+            burst.length = i - dataStart;
+            appendBurst(burst, head);
             dataStart = -1;
         }
 
         // Data ended & end of the file
         if ((dataStart != -1) && (i == (samplesCount - 1))) {
-            const QColor c = dataRead ? Qt::blue : Qt::red;
-            tf.setForeground(QBrush(c));
-            ui->decoderTextEdit->setCurrentCharFormat(tf);
-            ui->decoderTextEdit->appendPlainText(QString("%1: [....] %2 PIO data %3 (%4 bytes)")
-                                                     .arg(dataStart, 8, 16, QChar('0'))
-                                                     .arg(dataRead ? "<<" : ">>")
-                                                     .arg(dataRead ? "read" : "write")
-                                                     .arg((i - dataStart + 1) * 2));
-            printHexData(&file, dataStart, i - dataStart + 1);
+            ProfilerScope scope(&profiler, DECODE_BURST);
+            burst.length = i - dataStart + 1;
+            appendBurst(burst, head);
         }
 
+        // Structured decoding of IDENTIFY and S.M.A.R.T. data
+        {
+            ProfilerScope scope(&profiler, DECODE_PARSE);
+            if (parser.feed(item, i))
+                appendPayload(parser.transaction());
+        }
 
         if (dataStart == -1) {
+            ProfilerScope scope(&profiler, DECODE_TEXT);
             QString ascii = ".";
             if (((item.data & 0x00ff) >= 0x20) && ((item.data & 0x00ff) <= 0x7e))
                 ascii = QChar(item.data & 0x00ff);
@@ -315,7 +493,185 @@ void MainWindow::decodePressed()
         }
     }
 
+    if (parser.finish())
+        appendPayload(parser.transaction());
+
+    file.close();
+
+    if (profiler.isEnabled()) {
+        tf.setForeground(QBrush(QColor(Qt::black)));
+        ui->decoderTextEdit->setCurrentCharFormat(tf);
+        ui->decoderTextEdit->appendPlainText("Decoder profile:");
+        for (const QString &line : profiler.report())
+            ui->decoderTextEdit->appendPlainText(line);
+        if (profiler.saveTrace(path + ".decode.trace.json"))
+            ui->decoderTextEdit->appendPlainText(QString("Trace saved: %1.decode.trace.json").arg(path));
+    }
+}
+
+void MainWindow::diffPressed()
+{
+    const QString firstPath = QFileDialog::getOpenFileName(this,
+                                                           "Open a reference file",
+                                                           ui->locationEdit->text(),
+                                                           "Sniffer files (*.sniff);;All files (*.*)");
+    if (firstPath.isEmpty())
+        return;
+
+    const QString secondPath = QFileDialog::getOpenFileName(this,
+                                                            "Open a file to compare with",
+                                                            QFileInfo(firstPath).absolutePath(),
+                                                            "Sniffer files (*.sniff);;All files (*.*)");
+    if (secondPath.isEmpty())
+        return;
+
+    ui->decoderTextEdit->clear();
+    ui->timelineWidget->clear();
+
+    QTextCharFormat tf = ui->decoderTextEdit->currentCharFormat();
+    tf.setForeground(QBrush(QColor(Qt::black)));
+    ui->decoderTextEdit->setCurrentCharFormat(tf);
+
+    CaptureDiff diff;
+    if (!diff.compare(firstPath, secondPath)) {
+        ui->decoderTextEdit->appendPlainText(diff.errorString());
+        return;
+    }
+
+    ui->decoderTextEdit->appendPlainText(QString("--- %1 (%2 transactions)\n"
+                                                 "+++ %3 (%4 transactions)\n"
+                                                 "%5 matched, %6 differences")
+                                             .arg(firstPath)
+                                             .arg(diff.first().count())
+                                             .arg(secondPath)
+                                             .arg(diff.second().count())
+                                             .arg(diff.matched())
+                                             .arg(diff.differences().count()));
+
+    int lines = 0;
+    for (const diff_entry_t &d : diff.differences()) {
+
+        if (++lines > DIFF_MAX_LINES) {
+            tf.setForeground(QBrush(QColor(Qt::black)));
+            ui->decoderTextEdit->setCurrentCharFormat(tf);
+            ui->decoderTextEdit->appendPlainText(QString("... %1 more differences are not shown")
+                                                     .arg(diff.differences().count() - DIFF_MAX_LINES));
+            break;
+        }
+
+        QString s;
+        QColor color;
+
+        switch (d.kind) {
+        case DIFF_REMOVED:
+            color = Qt::red;
+            s = QString("%1 | --------: - %2")
+                    .arg(diff.first().at(d.first).offset, 8, 16, QChar('0'))
+                    .arg(transactionSummary(diff.first().at(d.first)));
+            break;
+        case DIFF_ADDED:
+            color = Qt::blue;
+            s = QString("-------- | %1: + %2")
+                    .arg(diff.second().at(d.second).offset, 8, 16, QChar('0'))
+                    .arg(transactionSummary(diff.second().at(d.second)));
+            break;
+        default: {
+            const transaction_t &a = diff.first().at(d.first);
+            const transaction_t &b = diff.second().at(d.second);
+            QStringList changes;
+            if (a.dataWords != b.dataWords)
+                changes.append(QString("data %1 vs %2 bytes").arg(a.dataWords * 2).arg(b.dataWords * 2));
+            else if (a.payloadHash != b.payloadHash)
+                changes.append("payload differs");
+            if (a.status != b.status)
+                changes.append(QString("STATUS [ %1 ] vs [ %2 ]").arg(ataStatus(a.status)).arg(ataStatus(b.status)));
+            if ((a.error != b.error) || (a.errorRead != b.errorRead))
+                changes.append(QString("ERROR [ %1 ] vs [ %2 ]").arg(ataError(a.error)).arg(ataError(b.error)));
+            if ((a.features != b.features) || (a.device != b.device))
+                changes.append("taskfile differs");
+            color = Qt::darkMagenta;
+            s = QString("%1 | %2: ~ %3: %4")
+                    .arg(a.offset, 8, 16, QChar('0'))
+                    .arg(b.offset, 8, 16, QChar('0'))
+                    .arg(transactionSummary(a))
+                    .arg(changes.join(", "));
+        }
+        }
+
+        tf.setForeground(QBrush(color));
+        ui->decoderTextEdit->setCurrentCharFormat(tf);
+        ui->decoderTextEdit->appendPlainText(s);
+    }
+}
+
+void MainWindow::anomaliesPressed()
+{
+    const QString path = QFileDialog::getOpenFileName(this,
+                                                      "Open a file to check",
+                                                      ui->locationEdit->text(),
+                                                      "Sniffer files (*.sniff);;All files (*.*)");
+    if (path.isEmpty())
+        return;
+
+    ui->decoderTextEdit->clear();
+    ui->timelineWidget->clear();
+
+    QTextCharFormat tf = ui->decoderTextEdit->currentCharFormat();
+    tf.setForeground(QBrush(QColor(Qt::black)));
+    ui->decoderTextEdit->setCurrentCharFormat(tf);
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        ui->decoderTextEdit->appendPlainText(QString("File opening error: %1\n%2")
+                                                 .arg(path)
+                                                 .arg(file.errorString()));
+        return;
+    }
+
+    AnomalyDetector detector;
+    detector.setKnownCommands(knownCommands());
+
+    QByteArray buffer(PARSER_READ_SIZE, 0);
+    qint64 index = 0;
+    qint64 br;
+    while ((br = file.read(buffer.data(), buffer.size())) >= (qint64)sizeof(sniffer_item_t)) {
+        const int count = br / sizeof(sniffer_item_t);
+        detector.feed((const sniffer_item_t*)buffer.constData(), count, index);
+        index += count;
+    }
+    detector.finish();
     file.close();
+
+    ui->decoderTextEdit->appendPlainText(QString("%1: %2 samples, %3 anomalies")
+                                             .arg(path)
+                                             .arg(index)
+                                             .arg(detector.total()));
+    for (int rule = 0; rule < ANOMALY_RULES_COUNT; rule++)
+        ui->decoderTextEdit->appendPlainText(QString("    %1: %2")
+                                                 .arg(AnomalyDetector::ruleName(rule))
+                                                 .arg(detector.count(rule)));
+
+    tf.setForeground(QBrush(QColor(Qt::darkMagenta)));
+    ui->decoderTextEdit->setCurrentCharFormat(tf);
+    for (const anomaly_t &a : detector.anomalies())
+        ui->decoderTextEdit->appendPlainText(QString("%1: %2")
+                                                 .arg(a.offset, 8, 16, QChar('0'))
+                                                 .arg(AnomalyDetector::describe(a)));
+
+    if (!detector.save(path + ".anomalies"))
+        message(QString("File writing error: %1.anomalies").arg(path));
+}
+
+void MainWindow::batchTriggered()
+{
+    const QString dir = QFileDialog::getExistingDirectory(this,
+                                                          "Batch processing",
+                                                          ui->locationEdit->text());
+    if (dir.isEmpty())
+        return;
+
+    ui->actionBatch->setEnabled(false);
+    emit batch(dir);
 }
 
 void MainWindow::exportPressed()
@@ -338,10 +694,47 @@ void MainWindow::exportPressed()
     file.close();
 }
 
-void MainWindow::updateStatistics(quint32 bytesCommited, quint32 errorCount)
+void MainWindow::updateStatistics(int device, const statistics_t &st)
 {
-    ui->statisticsLabel->setText(QString("<b>Samples collected: %1, error count: %2</b>")
-                                     .arg(bytesCommited / sizeof(sniffer_item_t)).arg(errorCount));
+    statistics.insert(device, st);
+
+    if (sniffers.count() == 1) {
+        const QString counters = QString("<b>Samples collected: %1, error count: %2, anomalies: %3</b><br>")
+                                     .arg(st.samplesCollected)
+                                     .arg(st.errorCount)
+                                     .arg(st.anomalies);
+        const QString rates = QString("%1 samples/s, %2 MB/s, buffer fill %3%<br>"
+                                      "DATA %4%, STATUS %5%, taskfile %6%, %7 commands/s")
+                                  .arg(st.samplesPerSecond, 0, 'f', 0)
+                                  .arg(st.bytesPerSecond / 1e6, 0, 'f', 2)
+                                  .arg(st.bufferFill, 0, 'f', 1)
+                                  .arg(st.dataShare, 0, 'f', 1)
+                                  .arg(st.statusShare, 0, 'f', 1)
+                                  .arg(st.taskfileShare, 0, 'f', 1)
+                                  .arg(st.commandsPerSecond, 0, 'f', 1);
+        ui->statisticsLabel->setText(counters + rates);
+        return;
+    }
+
+    // One line per device
+    QStringList lines;
+    double total = 0;
+    for (auto i = statistics.constBegin(); i != statistics.constEnd(); ++i) {
+        const statistics_t &v = i.value();
+        lines.append(QString("<b>#%1: %2 samples, %3 errors, %8 anomalies</b>, %4 MB/s, fill %5%, DATA %6%, %7 commands/s")
+                         .arg(i.key() + 1)
+                         .arg(v.samplesCollected)
+                         .arg(v.errorCount)
+                         .arg(v.bytesPerSecond / 1e6, 0, 'f', 2)
+                         .arg(v.bufferFill, 0, 'f', 1)
+                         .arg(v.dataShare, 0, 'f', 1)
+                         .arg(v.commandsPerSecond, 0, 'f', 1)
+                         .arg(v.anomalies));
+        total += v.bytesPerSecond;
+    }
+    lines.append(QString("<b>Total: %1 MB/s</b>").arg(total / 1e6, 0, 'f', 2));
+
+    ui->statisticsLabel->setText(lines.join("<br>"));
 }
 
 void MainWindow::about()
@@ -380,6 +773,16 @@ QString MainWindow::ataError(quint8 error)
     return s.trimmed();
 }
 
+QString MainWindow::transactionSummary(const transaction_t &t)
+{
+    return QString("COMMAND (%1) LBA 0x%2 count %3, %4 bytes, STATUS [ %5 ]")
+        .arg(ataCommand(t.command))
+        .arg(t.lba, 0, 16)
+        .arg(t.sectorCount)
+        .arg(t.dataWords * 2)
+        .arg(ataStatus(t.status));
+}
+
 QString MainWindow::ataCommand(quint8 command)
 {
     if (ataCodes.contains(command))
@@ -388,10 +791,149 @@ QString MainWindow::ataCommand(quint8 command)
         return "UNKNOWN";
 }
 
-void MainWindow::printHexData(QFile *file, int offset, int length)
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
 {
-    sniffer_item_t item;
-    file->seek(offset * sizeof(item));
+    // Double click on a data summary line expands or collapses the hex dump
+    if ((watched == ui->decoderTextEdit->viewport()) && (event->type() == QEvent::MouseButtonDblClick)) {
+        const QMouseEvent *e = static_cast<QMouseEvent*>(event);
+        const QTextBlock block = ui->decoderTextEdit->cursorForPosition(e->pos()).block();
+        if (toggleBurst(block))
+            return true;
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::appendBurst(const data_burst_t &burst, const QVector<quint16> &head)
+{
+    bursts.insert(burst.offset, burst);
+
+    QTextCharFormat tf = ui->decoderTextEdit->currentCharFormat();
+    tf.setForeground(QBrush(QColor(burst.read ? Qt::blue : Qt::red)));
+    ui->decoderTextEdit->setCurrentCharFormat(tf);
+    ui->decoderTextEdit->appendPlainText(QString("%1: [....] %2 PIO data %3 (%4 bytes), sum %5, %6 [+]")
+                                             .arg(burst.offset, 8, 16, QChar('0'))
+                                             .arg(burst.read ? "<<" : ">>")
+                                             .arg(burst.read ? "read" : "write")
+                                             .arg(burst.length * 2)
+                                             .arg(burst.checksum, 4, 16, QChar('0'))
+                                             .arg(burstHint(burst, head)));
+}
+
+QString MainWindow::burstHint(const data_burst_t &burst, const QVector<quint16> &head)
+{
+    if (burst.zeros)
+        return "all zeros";
+
+    if (burst.ones)
+        return "all ones";
+
+    // IDENTIFY DEVICE model number is stored in words 27...46
+    if (((burst.command == 0xec) || (burst.command == 0xa1)) && (head.count() >= 47))
+        return QString("IDENTIFY \"%1\"").arg(PayloadDecoder::ataString(head.constData(), 27, 46));
+
+    if (burst.command == 0xb0)
+        return "S.M.A.R.T. data";
+
+    // Mostly printable content
+    int printable = 0;
+    for (const quint16 w : head) {
+        printable += ((w & 0xff) >= 0x20) && ((w & 0xff) <= 0x7e);
+        printable += ((w >> 8) >= 0x20) && ((w >> 8) <= 0x7e);
+    }
+    if (printable * 10 >= head.count() * 2 * 9)
+        return "text";
+
+    return "binary";
+}
+
+void MainWindow::appendPayload(const transaction_t &t)
+{
+    QStringList lines;
+
+    if (const identify_t *id = payloads.identify(t))
+        lines = PayloadDecoder::format(*id);
+    else if (const smart_t *smart = payloads.smart(t))
+        lines = PayloadDecoder::format(*smart);
+    else
+        return;
+
+    QTextCharFormat tf = ui->decoderTextEdit->currentCharFormat();
+    tf.setForeground(QBrush(QColor(Qt::darkCyan)));
+    ui->decoderTextEdit->setCurrentCharFormat(tf);
+    ui->decoderTextEdit->appendPlainText(lines.join('\n'));
+}
+
+bool MainWindow::toggleBurst(const QTextBlock &block)
+{
+    const QString text = block.text();
+    if (!text.contains("PIO data"))
+        return false;
+
+    bool ok = false;
+    const qint64 offset = text.section(':', 0, 0).toLongLong(&ok, 16);
+    if (!ok || !bursts.contains(offset))
+        return false;
+
+    const data_burst_t &burst = bursts[offset];
+    const bool expanded = text.endsWith("[-]");
+
+    QTextCursor cursor(block);
+    cursor.beginEditBlock();
+
+    // Toggle the marker
+    cursor.setPosition(block.position() + block.length() - 4);
+    cursor.setPosition(block.position() + block.length() - 1, QTextCursor::KeepAnchor);
+    cursor.insertText(expanded ? "[+]" : "[-]");
+
+    if (expanded) {
+        // Hex lines follow the summary line
+        const int lines = expandedLines.take(offset);
+        QTextBlock last = block;
+        for (int i = 0; (i < lines) && last.next().isValid(); i++)
+            last = last.next();
+        cursor.setPosition(block.position() + block.length() - 1);
+        cursor.setPosition(last.position() + last.length() - 1, QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+    } else {
+        // Recently expanded bursts are taken from the cache
+        QStringList lines;
+        if (hexCache.contains(offset)) {
+            lines = *hexCache.object(offset);
+        } else {
+            bool ok = false;
+            lines = hexLines(burst.offset, burst.length, &ok);
+            if (ok)
+                hexCache.insert(offset, new QStringList(lines), lines.count());
+        }
+        expandedLines.insert(offset, lines.count());
+        cursor.setPosition(block.position() + block.length() - 1);
+        cursor.insertText("\n" + lines.join('\n'));
+    }
+
+    cursor.endEditBlock();
+    return true;
+}
+
+QStringList MainWindow::hexLines(qint64 offset, int length, bool *ok)
+{
+    QStringList lines;
+    if (ok)
+        *ok = false;
+
+    QFile file(decodedPath);
+    if (!file.open(QFile::ReadOnly)) {
+        lines.append(QString("    File opening error: %1").arg(decodedPath));
+        return lines;
+    }
+
+    QVector<sniffer_item_t> items(length);
+    file.seek(offset * sizeof(sniffer_item_t));
+    if (file.read((char*)items.data(), length * sizeof(sniffer_item_t)) != qint64(length * sizeof(sniffer_item_t))) {
+        lines.append("    File reading error!");
+        return lines;
+    }
+    file.close();
 
     QString s;
     QString ascii;
@@ -407,7 +949,7 @@ void MainWindow::printHexData(QFile *file, int offset, int length)
             if ((i + j) >= length)
                 continue;
 
-            file->read((char*)&item, sizeof(item));
+            const sniffer_item_t &item = items.at(i + j);
             s.append(QString("%1 ").arg(item.data & 0x00ff, 2, 16, QChar('0')));
             s.append(QString("%1 ").arg(item.data >> 8, 2, 16, QChar('0')));
 
@@ -423,32 +965,21 @@ void MainWindow::printHexData(QFile *file, int offset, int length)
 
         }
 
-        ui->decoderTextEdit->appendPlainText(QString("%1| %2").arg(s).arg(ascii));
+        lines.append(QString("%1| %2").arg(s).arg(ascii));
     }
+
+    if (ok)
+        *ok = true;
+    return lines;
 }
 
-void MainWindow::loadAtaCommandCodes()
+QBitArray MainWindow::knownCommands()
 {
-    QFile file("AtaCommandCodes.txt");
-
-    if (!file.open(QFile::ReadOnly | QFile::Text)) {
-        ui->reportTextEdit->appendPlainText(QString("File opening error: %1").arg(file.fileName()));
-        return;
-    }
-
-    while (!file.atEnd()) {
-        const QString line = file.readLine();
-        const QStringList list = line.split(QChar('='));
-        if (list.length() < 2)
-            continue;
-        bool ok = false;
-        const quint8 key = list.at(0).trimmed().toUShort(&ok, 16);
-        if (!ok)
-            continue;
-        const QString value = list.at(1).trimmed();
-        if (!ataCodes.contains(key))
-            ataCodes.insert(key, value);
-    }
+    return AtaCommandCodes::known(ataCodes);
+}
 
-    file.close();
+void MainWindow::loadAtaCommandCodes()
+{
+    if (!AtaCommandCodes::load(ATA_COMMAND_CODES_FILE, &ataCodes))
+        ui->reportTextEdit->appendPlainText(QString("File opening error: %1").arg(ATA_COMMAND_CODES_FILE));
 }
@@ -13,7 +13,29 @@
 #include <QThread>
 #include <QFile>
 #include <QMap>
+#include <QHash>
+#include <QCache>
+#include <QTextBlock>
 #include "UsbSniffer/UsbSniffer.h"
+#include "SnifferItem.h"
+#include "TransactionParser/TransactionParser.h"
+#include "PayloadDecoder/PayloadDecoder.h"
+#include "BatchProcessor/BatchProcessor.h"
+
+#define DIFF_MAX_LINES          (10000)
+#define BURST_HEAD_WORDS        (256)   /* Words kept for content hints */
+#define HEX_CACHE_LINES         (65536) /* Hex lines of recently expanded bursts */
+
+// Continuous DATA sequence shown as a single collapsible line
+typedef struct {
+    qint64 offset;      // First DATA sample
+    int length;         // Samples count
+    bool read;          // Data flow direction
+    quint16 checksum;   // Sum of all words
+    quint8 command;     // Last command before the data
+    bool zeros;         // All words are 0x0000
+    bool ones;          // All words are 0xffff
+} data_burst_t;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -29,46 +51,62 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     void message(const QString &s);
+    void deviceMessage(int device, const QString &s);
+    void deviceInitialized(int device);
+    void deviceStarted();
+    void deviceStopped();
     void lockInterface();
     void unlockInterface();
     void findLocation();
     void startPressed();
+    void tunePressed();
+    void tuned(int device, int clkDiv, int transferSize);
     void decodePressed();
     void exportPressed();
-    void updateStatistics(quint32 bytesCommited, quint32 errorCount);
+    void diffPressed();
+    void anomaliesPressed();
+    void batchTriggered();
+    void updateStatistics(int device, const statistics_t &st);
     void about();
 
 signals:
-    void start(const QString &path, int clkDiv);
+    void batch(const QString &dir);
 
 private:
     Ui::MainWindow *ui;
-    QThread *thread;
-    UsbSniffer *sniffer;
+    QList<QThread*> threads;
+    QList<UsbSniffer*> sniffers;
+    QThread *batchThread;
+    BatchProcessor *processor;
+    QMap<int, statistics_t> statistics;
+    QVector<bool> ready;    // Devices opened successfully
+    int running;    // Devices started and not reported stop yet
     QMap<quint8, QString> ataCodes;
+    QString decodedPath;
+    QHash<qint64, data_burst_t> bursts;
+    QCache<qint64, QStringList> hexCache;
+    QHash<qint64, int> expandedLines;   // Lines inserted under expanded bursts
+    PayloadDecoder payloads;
+    int tuningMode;
+    int tunedClkDiv;
 
     QString ataStatus(quint8 status);
     QString ataError(quint8 error);
     QString ataCommand(quint8 command);
-    void printHexData(QFile *file, int offset, int length);
+    QString transactionSummary(const transaction_t &t);
+    QString tuningGroup(int pioMode);
+    void appendBurst(const data_burst_t &burst, const QVector<quint16> &head);
+    QString burstHint(const data_burst_t &burst, const QVector<quint16> &head);
+    void appendPayload(const transaction_t &t);
+    bool toggleBurst(const QTextBlock &block);
+    QStringList hexLines(qint64 offset, int length, bool *ok = nullptr);
     void loadAtaCommandCodes();
+    QBitArray knownCommands();
 };
 
-#pragma pack(push, 1)
-
-typedef struct {
-    quint16 data;
-    quint8 address:5;
-    quint8 unused1:3;
-    quint8 dior:1;
-    quint8 diow:1;
-    quint8 unused2:6;
-} sniffer_item_t;
-
-static_assert(sizeof(sniffer_item_t) == 4, "Incorrect 'sniffer_item_t' size!");
-
-#pragma pack(pop)
-
 #endif // MAINWINDOW_H
@@ -0,0 +1,229 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "PayloadDecoder.h"
+#include <QtEndian>
+
+const identify_t *PayloadDecoder::identify(const transaction_t &t)
+{
+    if (!isIdentify(t))
+        return nullptr;
+
+    auto it = identifyCache.find(t.offset);
+    if (it == identifyCache.end())
+        it = identifyCache.insert(t.offset, decodeIdentify(t.payload, t.command));
+
+    return &it.value();
+}
+
+const smart_t *PayloadDecoder::smart(const transaction_t &t)
+{
+    if (!isSmart(t))
+        return nullptr;
+
+    auto it = smartCache.find(t.offset);
+    if (it == smartCache.end())
+        it = smartCache.insert(t.offset, decodeSmart(t.payload));
+
+    return &it.value();
+}
+
+void PayloadDecoder::clear()
+{
+    identifyCache.clear();
+    smartCache.clear();
+}
+
+bool PayloadDecoder::isIdentify(const transaction_t &t)
+{
+    return ((t.command == 0xec) || (t.command == 0xa1))
+           && (t.payload.size() == PARSER_PAYLOAD_SIZE);
+}
+
+bool PayloadDecoder::isSmart(const transaction_t &t)
+{
+    return (t.command == 0xb0) && ((t.features & 0xff) == 0xd0)
+           && (t.payload.size() == PARSER_PAYLOAD_SIZE);
+}
+
+identify_t PayloadDecoder::decodeIdentify(const QByteArray &payload, quint8 command)
+{
+    identify_t id = {};
+    if (payload.size() < PARSER_PAYLOAD_SIZE)
+        return id;
+
+    quint16 w[256];
+    for (int i = 0; i < 256; i++)
+        w[i] = qFromLittleEndian<quint16>(payload.constData() + i * 2);
+
+    id.serial = ataString(w, 10, 19);
+    id.firmware = ataString(w, 23, 26);
+    id.model = ataString(w, 27, 46);
+    id.dma = w[49] & (1 << 8);
+
+    // Bits 15:14 of word 0 are 10b for ATAPI devices
+    id.packet = (command == 0xa1) || ((w[0] & 0xc000) == 0x8000);
+    if (!id.packet) {
+        id.lba = w[49] & (1 << 9);
+        id.lba48 = w[83] & (1 << 10);
+        id.sectors = id.lba48 ? ((quint64)w[103] << 48) | ((quint64)w[102] << 32) | ((quint64)w[101] << 16) | w[100]
+                              : ((quint64)w[61] << 16) | w[60];
+    }
+    id.rotationRate = ((w[217] == 1) || ((w[217] >= 0x0401) && (w[217] < 0xffff))) ? w[217] : 0;
+
+    // Bits of word 80 are ATA/ATAPI major versions
+    id.majorVersion = 0;
+    if ((w[80] != 0x0000) && (w[80] != 0xffff)) {
+        for (int i = 15; i > 0; i--) {
+            if (w[80] & (1 << i)) {
+                id.majorVersion = i;
+                break;
+            }
+        }
+    }
+
+    // Supported feature sets, words 82 and 83 are valid if bit 14 is set and bit 15 is cleared
+    if ((w[83] & 0xc000) == 0x4000) {
+        const struct { int word; int bit; const char *name; } list[] = {
+            { 82,  0, "S.M.A.R.T." },
+            { 82,  1, "Security" },
+            { 82,  3, "Power management" },
+            { 82,  5, "Write cache" },
+            { 82,  6, "Look-ahead" },
+            { 82, 10, "HPA" },
+            { 83,  3, "APM" },
+            { 83,  5, "PUIS" },
+            { 83,  9, "AAM" },
+            { 83, 10, "48-bit LBA" },
+            { 83, 11, "DCO" },
+            { 83, 12, "FLUSH CACHE" },
+            { 83, 13, "FLUSH CACHE EXT" }
+        };
+        for (const auto &f : list) {
+            if (w[f.word] & (1 << f.bit))
+                id.features.append(f.name);
+        }
+    }
+
+    return id;
+}
+
+smart_t PayloadDecoder::decodeSmart(const QByteArray &payload)
+{
+    smart_t smart = {};
+    if (payload.size() < PARSER_PAYLOAD_SIZE)
+        return smart;
+
+    const uchar *p = (const uchar*)payload.constData();
+    smart.revision = qFromLittleEndian<quint16>(p);
+
+    // Attributes table starts at offset 2, 12 bytes per entry
+    for (int i = 0; i < SMART_ATTRIBUTES_COUNT; i++) {
+        const uchar *e = p + 2 + i * 12;
+        if (e[0] == 0)
+            continue;
+
+        smart_attribute_t a;
+        a.id = e[0];
+        a.flags = qFromLittleEndian<quint16>(e + 1);
+        a.value = e[3];
+        a.worst = e[4];
+        a.raw = 0;
+        for (int j = 5; j >= 0; j--)
+            a.raw = (a.raw << 8) | e[5 + j];
+        smart.attributes.append(a);
+    }
+
+    return smart;
+}
+
+QStringList PayloadDecoder::format(const identify_t &id)
+{
+    QStringList lines;
+
+    lines.append(QString("    Model: \"%1\", serial: \"%2\", firmware: \"%3\"")
+                     .arg(id.model)
+                     .arg(id.serial)
+                     .arg(id.firmware));
+    if (id.packet)
+        lines.append(QString("    Packet device%1").arg(id.dma ? ", DMA" : ""));
+    else
+        lines.append(QString("    Capacity: %1 sectors (%2 GB), %3%4")
+                         .arg(id.sectors)
+                         .arg(id.sectors * 512 / 1000000000.0, 0, 'f', 1)
+                         .arg(id.lba48 ? "LBA48" : (id.lba ? "LBA28" : "CHS"))
+                         .arg(id.dma ? ", DMA" : ""));
+    if (id.majorVersion > 0)
+        lines.append(QString("    Major version: %1, %2")
+                         .arg(id.majorVersion >= 8 ? QString("ACS-%1").arg(id.majorVersion - 7)
+                                                   : QString("ATA/ATAPI-%1").arg(id.majorVersion))
+                         .arg(id.rotationRate == 1 ? QString("non-rotating media")
+                                                   : (id.rotationRate ? QString("%1 rpm").arg(id.rotationRate)
+                                                                      : QString("rotation rate not reported"))));
+    lines.append(QString("    Features: %1").arg(id.features.join(", ")));
+
+    return lines;
+}
+
+QStringList PayloadDecoder::format(const smart_t &smart)
+{
+    QStringList lines;
+
+    lines.append(QString("    S.M.A.R.T. data revision %1, %2 attributes")
+                     .arg(smart.revision)
+                     .arg(smart.attributes.count()));
+    lines.append("     ID Name                          Flags  Value Worst Raw");
+
+    for (const smart_attribute_t &a : smart.attributes)
+        lines.append(QString("    %1 %2 0x%3 %4   %5   %6")
+                         .arg(a.id, 3)
+                         .arg(attributeName(a.id), -29)
+                         .arg(a.flags, 4, 16, QChar('0'))
+                         .arg(a.value, 3)
+                         .arg(a.worst, 3)
+                         .arg(a.raw));
+
+    return lines;
+}
+
+QString PayloadDecoder::ataString(const quint16 *words, int first, int last)
+{
+    // ATA strings keep two characters per word, the first one in the high byte
+    QString s;
+    for (int i = first; i <= last; i++) {
+        const char c[2] = { char(words[i] >> 8), char(words[i] & 0xff) };
+        for (const char ch : c)
+            s.append(((ch >= 0x20) && (ch <= 0x7e)) ? QChar(ch) : QChar(' '));
+    }
+
+    return s.trimmed();
+}
+
+QString PayloadDecoder::attributeName(quint8 id)
+{
+    switch (id) {
+    case 1:   return "Raw Read Error Rate";
+    case 3:   return "Spin-Up Time";
+    case 4:   return "Start/Stop Count";
+    case 5:   return "Reallocated Sectors Count";
+    case 7:   return "Seek Error Rate";
+    case 9:   return "Power-On Hours";
+    case 10:  return "Spin Retry Count";
+    case 12:  return "Power Cycle Count";
+    case 187: return "Reported Uncorrectable";
+    case 188: return "Command Timeout";
+    case 190: return "Airflow Temperature";
+    case 194: return "Temperature";
+    case 196: return "Reallocation Event Count";
+    case 197: return "Current Pending Sectors";
+    case 198: return "Offline Uncorrectable";
+    case 199: return "UDMA CRC Error Count";
+    case 200: return "Multi-Zone Error Rate";
+    default:  return "Unknown";
+    }
+}
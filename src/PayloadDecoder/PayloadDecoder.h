@@ -0,0 +1,72 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef PAYLOADDECODER_H
+#define PAYLOADDECODER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include "TransactionParser/TransactionParser.h"
+
+#define SMART_ATTRIBUTES_COUNT  (30)
+
+// IDENTIFY DEVICE and IDENTIFY PACKET DEVICE data
+typedef struct {
+    QString model;
+    QString serial;
+    QString firmware;
+    bool packet;            // ATAPI device, capacity and addressing words are reserved
+    quint64 sectors;        // User addressable sectors
+    bool lba;
+    bool lba48;
+    bool dma;
+    int majorVersion;       // Highest supported ATA/ATAPI version, 0 if not reported
+    quint16 rotationRate;   // 1 for non-rotating media, 0 if not reported
+    QStringList features;   // Supported feature sets
+} identify_t;
+
+typedef struct {
+    quint8 id;
+    quint16 flags;
+    quint8 value;
+    quint8 worst;
+    quint64 raw;            // 48 bits
+} smart_attribute_t;
+
+// S.M.A.R.T. READ DATA
+typedef struct {
+    quint16 revision;
+    QVector<smart_attribute_t> attributes;
+} smart_t;
+
+// Structured decoders of IDENTIFY DEVICE and S.M.A.R.T. READ DATA payloads.
+// Results are cached by the transaction offset, so every transaction is decoded once.
+class PayloadDecoder
+{
+public:
+    const identify_t *identify(const transaction_t &t);
+    const smart_t *smart(const transaction_t &t);
+    void clear();
+
+    static bool isIdentify(const transaction_t &t);
+    static bool isSmart(const transaction_t &t);
+    static identify_t decodeIdentify(const QByteArray &payload, quint8 command = 0xec);
+    static smart_t decodeSmart(const QByteArray &payload);
+    static QStringList format(const identify_t &id);
+    static QStringList format(const smart_t &smart);
+    static QString ataString(const quint16 *words, int first, int last);
+    static QString attributeName(quint8 id);
+
+private:
+    QHash<qint64, identify_t> identifyCache;
+    QHash<qint64, smart_t> smartCache;
+};
+
+#endif // PAYLOADDECODER_H
@@ -0,0 +1,130 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "Profiler.h"
+#include <QFile>
+#include <QtAlgorithms>
+
+Profiler::Profiler(const QStringList &stages, const QStringList &counters)
+    : stageNames(stages),
+    counterNames(counters),
+    enabled(false),
+    trace(false),
+    tid(0),
+    dropped(0)
+{
+    reset(false);
+}
+
+void Profiler::reset(bool enabled, bool trace)
+{
+    this->enabled = enabled;
+    this->trace = enabled && trace;
+
+    stats.fill({}, stageNames.count());
+    counters.fill(0, counterNames.count());
+    events.clear();
+    dropped = 0;
+
+    if (this->trace)
+        events.reserve(PROFILER_MAX_EVENTS / 16);
+
+    timer.start();
+}
+
+void Profiler::end(int stage, qint64 started)
+{
+    if (!enabled)
+        return;
+
+    const qint64 now = timer.nsecsElapsed();
+    const quint64 duration = qMax<qint64>(0, now - started);
+
+    stage_stat_t &s = stats[stage];
+    s.count++;
+    s.total += duration;
+    s.max = qMax(s.max, duration);
+
+    // Bucket N keeps durations below 2^N ns
+    const int bucket = duration ? (64 - qCountLeadingZeroBits(duration)) : 0;
+    s.histogram[qMin(bucket, PROFILER_BUCKETS - 1)]++;
+
+    if (trace) {
+        if (events.count() < PROFILER_MAX_EVENTS)
+            events.append({quint32(stage), started, qint64(duration)});
+        else
+            dropped++;
+    }
+}
+
+QStringList Profiler::report() const
+{
+    QStringList lines;
+
+    for (int i = 0; i < stageNames.count(); i++) {
+        const stage_stat_t &s = stats.at(i);
+        if (s.count == 0)
+            continue;
+        lines.append(QString("  %1: %2 calls, avg %3 us, p50 < %4 us, p99 < %5 us, max %6 us")
+                         .arg(stageNames.at(i), -8)
+                         .arg(s.count)
+                         .arg(s.total / 1000.0 / s.count, 0, 'f', 1)
+                         .arg(percentile(s, 0.50) / 1000.0, 0, 'f', 1)
+                         .arg(percentile(s, 0.99) / 1000.0, 0, 'f', 1)
+                         .arg(s.max / 1000.0, 0, 'f', 1));
+    }
+
+    for (int i = 0; i < counterNames.count(); i++)
+        lines.append(QString("  %1: %2").arg(counterNames.at(i)).arg(counters.at(i)));
+
+    if (dropped)
+        lines.append(QString("  %1 trace events dropped").arg(dropped));
+
+    return lines;
+}
+
+bool Profiler::saveTrace(const QString &path) const
+{
+    if (!trace)
+        return false;
+
+    QFile file(path);
+    if (!file.open(QFile::WriteOnly | QFile::Text))
+        return false;
+
+    // Chrome trace event format, complete events with microsecond timestamps
+    file.write("{\"traceEvents\":[\n");
+    for (int i = 0; i < events.count(); i++) {
+        const trace_event_t &e = events.at(i);
+        file.write(QString("{\"name\":\"%1\",\"ph\":\"X\",\"ts\":%2,\"dur\":%3,\"pid\":1,\"tid\":%4}%5\n")
+                       .arg(stageNames.at(e.stage))
+                       .arg(e.start / 1000.0, 0, 'f', 3)
+                       .arg(e.duration / 1000.0, 0, 'f', 3)
+                       .arg(tid)
+                       .arg((i + 1 < events.count()) ? "," : "")
+                       .toUtf8());
+    }
+    file.write("],\"displayTimeUnit\":\"ns\"}\n");
+
+    file.close();
+    return true;
+}
+
+quint64 Profiler::percentile(const stage_stat_t &s, double p)
+{
+    // Upper bound of the bucket containing the percentile
+    const quint64 target = qMax<quint64>(1, s.count * p);
+    quint64 n = 0;
+    for (int i = 0; i < PROFILER_BUCKETS; i++) {
+        n += s.histogram[i];
+        if (n >= target)
+            return qMin(s.max, quint64(1) << i);
+    }
+
+    return s.max;
+}
@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QStringList>
+#include <QVector>
+#include <QElapsedTimer>
+
+#define PROFILER_BUCKETS        (40)      /* log2 of nanoseconds, up to ~9 minutes */
+#define PROFILER_MAX_EVENTS     (1000000) /* Trace events kept, the rest are dropped */
+
+typedef struct {
+    quint64 count;
+    quint64 total;          // ns
+    quint64 max;            // ns
+    quint64 histogram[PROFILER_BUCKETS];
+} stage_stat_t;
+
+typedef struct {
+    quint32 stage;
+    qint64 start;           // ns
+    qint64 duration;        // ns
+} trace_event_t;
+
+// Per-stage latency histograms, counters and an optional Chrome trace.
+// When disabled every call is a single branch.
+class Profiler
+{
+public:
+    Profiler(const QStringList &stages, const QStringList &counters = QStringList());
+    void reset(bool enabled, bool trace = false);
+    bool isEnabled() const { return enabled; }
+    qint64 begin() const { return enabled ? timer.nsecsElapsed() : 0; }
+    void end(int stage, qint64 started);
+    void count(int counter, quint64 n = 1) { if (enabled) counters[counter] += n; }
+    void setThread(int tid) { this->tid = tid; }
+    QStringList report() const;
+    bool saveTrace(const QString &path) const;
+
+private:
+    QStringList stageNames;
+    QStringList counterNames;
+    QVector<stage_stat_t> stats;
+    QVector<quint64> counters;
+    QVector<trace_event_t> events;
+    QElapsedTimer timer;
+    bool enabled;
+    bool trace;
+    int tid;
+    quint64 dropped;
+    static quint64 percentile(const stage_stat_t &s, double p);
+};
+
+// Measures the scope it lives in
+class ProfilerScope
+{
+public:
+    ProfilerScope(Profiler *profiler, int stage)
+        : profiler(profiler), stage(stage), started(profiler->begin()) {}
+    ~ProfilerScope() { profiler->end(stage, started); }
+
+private:
+    Profiler *profiler;
+    int stage;
+    qint64 started;
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,65 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef SNIFFERITEM_H
+#define SNIFFERITEM_H
+
+#include <QtGlobal>
+#include "AtaRegisters.h"
+
+#pragma pack(push, 1)
+
+typedef struct {
+    quint16 data;
+    quint8 address:5;
+    quint8 unused1:3;
+    quint8 dior:1;
+    quint8 diow:1;
+    quint8 unused2:6;
+} sniffer_item_t;
+
+static_assert(sizeof(sniffer_item_t) == 4, "Incorrect 'sniffer_item_t' size!");
+
+#pragma pack(pop)
+
+typedef enum {
+    SAMPLE_INCORRECT,   // DIOR equal to DIOW
+    SAMPLE_DATA,        // DATA register access
+    SAMPLE_STATUS,      // STATUS or ALT_STATUS read
+    SAMPLE_COMMAND,     // COMMAND register write
+    SAMPLE_TASKFILE,    // Other command block register write
+    SAMPLE_OTHER
+} sample_kind_t;
+
+static inline sample_kind_t sampleKind(const sniffer_item_t &item)
+{
+    if (item.dior == item.diow)
+        return SAMPLE_INCORRECT;
+
+    const bool read = !item.dior;
+
+    switch (item.address) {
+    case ATA_REG_DATA:
+        return SAMPLE_DATA;
+    case ATA_REG_STATUS:
+        return read ? SAMPLE_STATUS : SAMPLE_COMMAND;
+    case ATA_REG_ALT_STATUS:
+        return read ? SAMPLE_STATUS : SAMPLE_OTHER;
+    case ATA_REG_ERROR:
+    case ATA_REG_SECTOR_COUNT:
+    case ATA_REG_LBA_LOW:
+    case ATA_REG_LBA_MID:
+    case ATA_REG_LBA_HIGH:
+    case ATA_REG_LBA_DEVICE:
+        return read ? SAMPLE_OTHER : SAMPLE_TASKFILE;
+    default:
+        return SAMPLE_OTHER;
+    }
+}
+
+#endif // SNIFFERITEM_H
@@ -0,0 +1,152 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "SummaryPyramid.h"
+#include <QFile>
+
+SummaryPyramid::SummaryPyramid()
+    : samplesCount(0)
+{
+
+}
+
+bool SummaryPyramid::build(const QString &path, const volatile bool *cancel)
+{
+    clear();
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    // Level 0 is built from raw samples
+    QVector<bucket_t> base;
+    base.reserve(file.size() / sizeof(sniffer_item_t) / PYRAMID_BASE_BUCKET + 1);
+
+    QByteArray buffer(PYRAMID_READ_SIZE, 0);
+    bucket_t bucket = emptyBucket();
+    int filled = 0;
+
+    while (true) {
+        if (cancel && *cancel) {
+            file.close();
+            clear();
+            return false;
+        }
+
+        const qint64 br = file.read(buffer.data(), buffer.size());
+        if (br < 0) {
+            file.close();
+            clear();
+            return false;
+        }
+        if (br < (qint64)sizeof(sniffer_item_t))
+            break;
+
+        const sniffer_item_t *item = (const sniffer_item_t*)buffer.constData();
+        const int count = br / sizeof(sniffer_item_t);
+
+        for (int i = 0; i < count; i++) {
+            append(&bucket, item[i]);
+            if (++filled == PYRAMID_BASE_BUCKET) {
+                base.append(bucket);
+                bucket = emptyBucket();
+                filled = 0;
+            }
+        }
+
+        samplesCount += count;
+    }
+
+    if (filled > 0)
+        base.append(bucket);
+
+    file.close();
+    pyramid.append(base);
+
+    // Every next level merges PYRAMID_FANOUT buckets of the previous one
+    while (pyramid.last().count() > 1) {
+        const QVector<bucket_t> &prev = pyramid.last();
+        QVector<bucket_t> next((prev.count() + PYRAMID_FANOUT - 1) / PYRAMID_FANOUT, emptyBucket());
+        for (int i = 0; i < prev.count(); i++)
+            merge(&next[i / PYRAMID_FANOUT], prev.at(i));
+        pyramid.append(next);
+    }
+
+    return true;
+}
+
+void SummaryPyramid::clear()
+{
+    samplesCount = 0;
+    pyramid.clear();
+}
+
+qint64 SummaryPyramid::bucketSize(int level) const
+{
+    qint64 n = PYRAMID_BASE_BUCKET;
+    for (int i = 0; i < level; i++)
+        n *= PYRAMID_FANOUT;
+    return n;
+}
+
+bucket_t SummaryPyramid::summary(qint64 first, qint64 last) const
+{
+    bucket_t result = emptyBucket();
+
+    if (pyramid.isEmpty() || (first > last))
+        return result;
+
+    // The coarsest level with buckets not exceeding the range
+    int level = 0;
+    while ((level + 1 < pyramid.count()) && (bucketSize(level + 1) <= (last - first + 1)))
+        level++;
+
+    const QVector<bucket_t> &buckets = pyramid.at(level);
+    const qint64 size = bucketSize(level);
+    const int from = first / size;
+    const int to = qMin<qint64>(last / size, buckets.count() - 1);
+
+    for (int i = from; i <= to; i++)
+        merge(&result, buckets.at(i));
+
+    return result;
+}
+
+void SummaryPyramid::append(bucket_t *bucket, const sniffer_item_t &item)
+{
+    switch (sampleKind(item)) {
+    case SAMPLE_DATA:
+        bucket->data++;
+        bucket->min = qMin(bucket->min, item.data);
+        bucket->max = qMax(bucket->max, item.data);
+        break;
+    case SAMPLE_STATUS:
+        bucket->status++;
+        break;
+    case SAMPLE_COMMAND:
+        bucket->command++;
+        break;
+    default:
+        bucket->other++;
+    }
+}
+
+void SummaryPyramid::merge(bucket_t *bucket, const bucket_t &other)
+{
+    bucket->data += other.data;
+    bucket->status += other.status;
+    bucket->command += other.command;
+    bucket->other += other.other;
+    bucket->min = qMin(bucket->min, other.min);
+    bucket->max = qMax(bucket->max, other.max);
+}
+
+bucket_t SummaryPyramid::emptyBucket()
+{
+    return { 0, 0, 0, 0, 0xffff, 0 };
+}
@@ -0,0 +1,51 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef SUMMARYPYRAMID_H
+#define SUMMARYPYRAMID_H
+
+#include <QString>
+#include <QVector>
+#include "SnifferItem.h"
+
+#define PYRAMID_BASE_BUCKET     (1024) /* Samples per bucket of level 0 */
+#define PYRAMID_FANOUT          (8)    /* Buckets of level N per bucket of level N+1 */
+#define PYRAMID_READ_SIZE       (1048576)
+
+typedef struct {
+    quint64 data;       // DATA register accesses
+    quint64 status;     // STATUS and ALT_STATUS reads
+    quint64 command;    // COMMAND register writes
+    quint64 other;      // Everything else
+    quint16 min;        // DATA register values range
+    quint16 max;
+} bucket_t;
+
+// Multi-resolution summary of a capture file. Level 0 holds one bucket
+// per PYRAMID_BASE_BUCKET samples, every next level is PYRAMID_FANOUT
+// times coarser, so any range is summarized by a few buckets.
+class SummaryPyramid
+{
+public:
+    SummaryPyramid();
+    bool build(const QString &path, const volatile bool *cancel = nullptr);
+    void clear();
+    qint64 samples() const { return samplesCount; }
+    int levels() const { return pyramid.count(); }
+    qint64 bucketSize(int level) const;
+    bucket_t summary(qint64 first, qint64 last) const;
+    static void append(bucket_t *bucket, const sniffer_item_t &item);
+    static void merge(bucket_t *bucket, const bucket_t &other);
+    static bucket_t emptyBucket();
+
+private:
+    qint64 samplesCount;
+    QVector<QVector<bucket_t>> pyramid;
+};
+
+#endif // SUMMARYPYRAMID_H
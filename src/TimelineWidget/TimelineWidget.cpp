@@ -0,0 +1,282 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "TimelineWidget.h"
+#include <QFile>
+#include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QtMath>
+#include <QRunnable>
+
+// Builds the summary pyramid of a file and hands it over to the widget
+class PyramidTask : public QRunnable
+{
+public:
+    PyramidTask(TimelineWidget *widget, const QString &path, int generation)
+        : widget(widget), path(path), generation(generation) {}
+
+    void run() override
+    {
+        SummaryPyramid pyramid;
+        const bool ok = pyramid.build(path, &widget->cancelBuild);
+
+        // The widget waits for the builder to finish before destruction
+        QMetaObject::invokeMethod(widget, [widget = widget, path = ok ? path : QString(), generation = generation, pyramid]() {
+            widget->built(generation, path, pyramid);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    TimelineWidget *widget;
+    QString path;
+    int generation;
+};
+
+TimelineWidget::TimelineWidget(QWidget *parent)
+    : QWidget(parent),
+    cancelBuild(false),
+    building(false),
+    generation(0),
+    viewStart(0),
+    samplesPerPixel(1),
+    dragX(0),
+    dragStart(0),
+    rawStart(0)
+{
+    setMinimumHeight(TIMELINE_RULER_HEIGHT + 3 * 24);
+    builder.setMaxThreadCount(1);
+}
+
+TimelineWidget::~TimelineWidget()
+{
+    cancelBuild = true;
+    builder.waitForDone();
+}
+
+void TimelineWidget::load(const QString &path)
+{
+    clear();
+
+    // A cancelled build stops within one read block
+    builder.waitForDone();
+    cancelBuild = false;
+    building = true;
+    builder.start(new PyramidTask(this, path, generation));
+    update();
+}
+
+void TimelineWidget::built(int generation, const QString &path, const SummaryPyramid &pyramid)
+{
+    if (generation != this->generation)
+        return;
+
+    building = false;
+    if (path.isEmpty()) {
+        update();
+        return;
+    }
+
+    this->pyramid = pyramid;
+    this->path = path;
+    fitAll();
+}
+
+void TimelineWidget::clear()
+{
+    cancelBuild = true;
+    building = false;
+    generation++;
+    pyramid.clear();
+    path.clear();
+    raw.clear();
+    rawStart = 0;
+    viewStart = 0;
+    samplesPerPixel = 1;
+    update();
+}
+
+void TimelineWidget::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter p(this);
+    p.fillRect(rect(), Qt::white);
+
+    const int laneHeight = (height() - TIMELINE_RULER_HEIGHT) / 3;
+    const int dataTop = TIMELINE_RULER_HEIGHT;
+    const int statusTop = dataTop + laneHeight;
+    const int commandTop = statusTop + laneHeight;
+    const int w = plotWidth();
+
+    // Lane labels
+    p.setPen(Qt::black);
+    p.drawText(QRect(0, dataTop, TIMELINE_LABELS_WIDTH, laneHeight), Qt::AlignCenter, "DATA");
+    p.drawText(QRect(0, statusTop, TIMELINE_LABELS_WIDTH, laneHeight), Qt::AlignCenter, "STATUS");
+    p.drawText(QRect(0, commandTop, TIMELINE_LABELS_WIDTH, laneHeight), Qt::AlignCenter, "COMMAND");
+    p.setPen(Qt::lightGray);
+    p.drawLine(TIMELINE_LABELS_WIDTH, statusTop, width(), statusTop);
+    p.drawLine(TIMELINE_LABELS_WIDTH, commandTop, width(), commandTop);
+
+    if (building) {
+        p.setPen(Qt::darkGray);
+        p.drawText(QRect(TIMELINE_LABELS_WIDTH, dataTop, w, height() - dataTop), Qt::AlignCenter, "Building overview...");
+        return;
+    }
+
+    if (pyramid.samples() == 0)
+        return;
+
+    // Raw samples are read only for deep zoom levels
+    if (samplesPerPixel < PYRAMID_BASE_BUCKET)
+        loadRaw(viewStart, viewStart + qCeil(w * samplesPerPixel));
+
+    // Ruler
+    p.setPen(Qt::darkGray);
+    for (int x = 0; x < w; x += 120) {
+        const qint64 sample = viewStart + qFloor(x * samplesPerPixel);
+        p.drawLine(TIMELINE_LABELS_WIDTH + x, 0, TIMELINE_LABELS_WIDTH + x, TIMELINE_RULER_HEIGHT);
+        p.drawText(TIMELINE_LABELS_WIDTH + x + 3, TIMELINE_RULER_HEIGHT - 4,
+                   QString("%1").arg(sample, 8, 16, QChar('0')));
+    }
+
+    for (int x = 0; x < w; x++) {
+
+        const qint64 first = viewStart + qFloor(x * samplesPerPixel);
+        const qint64 last = qMax(first, viewStart + qFloor((x + 1) * samplesPerPixel) - 1);
+        if (first >= pyramid.samples())
+            break;
+
+        const bucket_t b = column(first, qMin(last, pyramid.samples() - 1));
+        const quint64 total = (quint64)b.data + b.status + b.command + b.other;
+        if (total == 0)
+            continue;
+
+        const int px = TIMELINE_LABELS_WIDTH + x;
+
+        // DATA share as a bar, values range as an envelope
+        if (b.data > 0) {
+            const int h = qMax(1, int(laneHeight * b.data / total));
+            p.setPen(QColor(180, 200, 255));
+            p.drawLine(px, statusTop - 1, px, statusTop - h);
+            p.setPen(Qt::blue);
+            p.drawLine(px, statusTop - 1 - (laneHeight - 2) * b.min / 0xffff,
+                       px, statusTop - 1 - (laneHeight - 2) * b.max / 0xffff);
+        }
+
+        // STATUS polls share
+        if (b.status > 0) {
+            const int h = qMax(1, int(laneHeight * b.status / total));
+            p.setPen(Qt::darkGreen);
+            p.drawLine(px, commandTop - 1, px, commandTop - h);
+        }
+
+        // COMMAND boundaries
+        if (b.command > 0) {
+            p.setPen(Qt::red);
+            p.drawLine(px, commandTop + 1, px, commandTop + laneHeight - 1);
+        }
+    }
+}
+
+void TimelineWidget::wheelEvent(QWheelEvent *event)
+{
+    if (pyramid.samples() == 0)
+        return;
+
+    // Zoom around the cursor position
+    const double x = qMax(0.0, event->position().x() - TIMELINE_LABELS_WIDTH);
+    const double anchor = viewStart + x * samplesPerPixel;
+    const double factor = (event->angleDelta().y() > 0) ? 0.5 : 2.0;
+
+    samplesPerPixel = qBound(TIMELINE_MAX_ZOOM,
+                             samplesPerPixel * factor,
+                             qMax(1.0, double(pyramid.samples()) / plotWidth()));
+    viewStart = qRound64(anchor - x * samplesPerPixel);
+    clampView();
+    update();
+}
+
+void TimelineWidget::mousePressEvent(QMouseEvent *event)
+{
+    dragX = event->pos().x();
+    dragStart = viewStart;
+}
+
+void TimelineWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton))
+        return;
+
+    viewStart = dragStart - qRound64((event->pos().x() - dragX) * samplesPerPixel);
+    clampView();
+    update();
+}
+
+void TimelineWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    fitAll();
+}
+
+void TimelineWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    clampView();
+}
+
+void TimelineWidget::fitAll()
+{
+    viewStart = 0;
+    samplesPerPixel = qMax(1.0, double(pyramid.samples()) / plotWidth());
+    update();
+}
+
+void TimelineWidget::clampView()
+{
+    const qint64 visible = qCeil(plotWidth() * samplesPerPixel);
+    viewStart = qBound<qint64>(0, viewStart, qMax<qint64>(0, pyramid.samples() - visible));
+}
+
+void TimelineWidget::loadRaw(qint64 first, qint64 last)
+{
+    last = qMin(last, pyramid.samples() - 1);
+
+    // Already cached
+    if ((first >= rawStart) && (last < rawStart + raw.count()))
+        return;
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        raw.clear();
+        return;
+    }
+
+    raw.resize(last - first + 1);
+    file.seek(first * sizeof(sniffer_item_t));
+    const qint64 br = file.read((char*)raw.data(), raw.count() * sizeof(sniffer_item_t));
+    raw.resize(qMax<qint64>(0, br) / sizeof(sniffer_item_t));
+    rawStart = first;
+
+    file.close();
+}
+
+bucket_t TimelineWidget::column(qint64 first, qint64 last)
+{
+    if (samplesPerPixel >= PYRAMID_BASE_BUCKET)
+        return pyramid.summary(first, last);
+
+    bucket_t b = SummaryPyramid::emptyBucket();
+    for (qint64 i = first; i <= last; i++) {
+        if ((i < rawStart) || (i >= rawStart + raw.count()))
+            break;
+        SummaryPyramid::append(&b, raw.at(i - rawStart));
+    }
+
+    return b;
+}
@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef TIMELINEWIDGET_H
+#define TIMELINEWIDGET_H
+
+#include <QWidget>
+#include <QVector>
+#include <QThreadPool>
+#include "SummaryPyramid/SummaryPyramid.h"
+
+#define TIMELINE_LABELS_WIDTH   (60)
+#define TIMELINE_RULER_HEIGHT   (16)
+#define TIMELINE_MAX_ZOOM       (1.0 / 16) /* 16 pixels per sample */
+
+// Zoomable overview of the bus activity: DATA bursts, STATUS polls
+// and COMMAND writes. Wheel zooms around the cursor, drag pans the view.
+class TimelineWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit TimelineWidget(QWidget *parent = nullptr);
+    ~TimelineWidget();
+    void load(const QString &path);
+    void clear();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    friend class PyramidTask;
+    SummaryPyramid pyramid;
+    QString path;
+    QThreadPool builder;        // Pyramid is built in background
+    volatile bool cancelBuild;
+    bool building;
+    int generation;             // Drops results of outdated builds
+    qint64 viewStart;           // First visible sample
+    double samplesPerPixel;
+    int dragX;
+    qint64 dragStart;
+    QVector<sniffer_item_t> raw; // Raw samples cache for deep zoom levels
+    qint64 rawStart;
+
+    int plotWidth() const { return qMax(1, width() - TIMELINE_LABELS_WIDTH); }
+    void built(int generation, const QString &path, const SummaryPyramid &pyramid);
+    void fitAll();
+    void clampView();
+    void loadRaw(qint64 first, qint64 last);
+    bucket_t column(qint64 first, qint64 last);
+};
+
+#endif // TIMELINEWIDGET_H
@@ -0,0 +1,222 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#include "TransactionParser.h"
+#include <QFile>
+
+#define FNV_OFFSET_BASIS        (0xcbf29ce484222325ULL)
+#define FNV_PRIME               (0x00000100000001b3ULL)
+
+TransactionParser::TransactionParser()
+{
+    reset();
+}
+
+void TransactionParser::reset()
+{
+    current = {};
+    completed = {};
+    active = false;
+    keepPayload = false;
+    lastData = -2;
+    taskfileStart = -1;
+    features = 0;
+    sectorCount = 0;
+    lbaLow = 0;
+    lbaMid = 0;
+    lbaHigh = 0;
+    device = 0;
+}
+
+bool TransactionParser::feed(const sniffer_item_t &item, qint64 index)
+{
+    const sample_kind_t kind = sampleKind(item);
+    bool done = false;
+
+    // Taskfile write closes the previous transaction
+    if (((kind == SAMPLE_TASKFILE) || (kind == SAMPLE_COMMAND)) && active) {
+        completed = current;
+        active = false;
+        done = true;
+    }
+
+    switch (kind) {
+    case SAMPLE_TASKFILE:
+        if (taskfileStart < 0)
+            taskfileStart = index;
+        // Every register keeps the previous value for 48-bit commands
+        switch (item.address) {
+        case ATA_REG_FEATURES:
+            features = (features << 8) | (item.data & 0xff);
+            break;
+        case ATA_REG_SECTOR_COUNT:
+            sectorCount = (sectorCount << 8) | (item.data & 0xff);
+            break;
+        case ATA_REG_LBA_LOW:
+            lbaLow = (lbaLow << 8) | (item.data & 0xff);
+            break;
+        case ATA_REG_LBA_MID:
+            lbaMid = (lbaMid << 8) | (item.data & 0xff);
+            break;
+        case ATA_REG_LBA_HIGH:
+            lbaHigh = (lbaHigh << 8) | (item.data & 0xff);
+            break;
+        case ATA_REG_LBA_DEVICE:
+            device = item.data & 0xff;
+            break;
+        }
+        break;
+    case SAMPLE_COMMAND:
+        beginTransaction(item.data & 0xff, index);
+        break;
+    case SAMPLE_DATA:
+        if (active) {
+            if (lastData != index - 1) {
+                if (current.bursts == 0)
+                    current.dataRead = !item.dior;
+                current.bursts++;
+            }
+            current.dataWords++;
+            current.payloadHash = (current.payloadHash ^ item.data) * FNV_PRIME;
+            if (keepPayload && (current.payload.size() < PARSER_PAYLOAD_SIZE))
+                current.payload.append(char(item.data & 0xff)).append(char(item.data >> 8));
+        }
+        lastData = index;
+        break;
+    case SAMPLE_STATUS:
+        if (active) {
+            current.status = item.data & 0xff;
+            current.statusPolls++;
+        }
+        break;
+    case SAMPLE_OTHER:
+        if (active && !item.dior && (item.address == (ATA_REG_ERROR))) {
+            current.error = item.data & 0xff;
+            current.errorRead = true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return done;
+}
+
+bool TransactionParser::finish()
+{
+    if (!active)
+        return false;
+
+    completed = current;
+    active = false;
+    return true;
+}
+
+void TransactionParser::beginTransaction(quint8 command, qint64 index)
+{
+    current = {};
+    current.offset = index;
+    current.taskfileOffset = (taskfileStart < 0) ? index : taskfileStart;
+    current.command = command;
+    current.features = features;
+    current.sectorCount = sectorCount;
+    current.device = device;
+    current.payloadHash = FNV_OFFSET_BASIS;
+
+    if (isExtended(command)) {
+        current.lba = ((quint64)(lbaHigh >> 8) << 40)
+                      | ((quint64)(lbaMid >> 8) << 32)
+                      | ((quint64)(lbaLow >> 8) << 24)
+                      | ((quint64)(lbaHigh & 0xff) << 16)
+                      | ((quint64)(lbaMid & 0xff) << 8)
+                      | (lbaLow & 0xff);
+    } else {
+        current.sectorCount &= 0xff;
+        current.features &= 0xff;
+        current.lba = ((quint64)(device & 0x0f) << 24)
+                      | ((quint64)(lbaHigh & 0xff) << 16)
+                      | ((quint64)(lbaMid & 0xff) << 8)
+                      | (lbaLow & 0xff);
+    }
+
+    keepPayload = keepsPayload(command, current.features & 0xff);
+    if (keepPayload)
+        current.payload.reserve(PARSER_PAYLOAD_SIZE);
+
+    active = true;
+    taskfileStart = -1;
+}
+
+bool TransactionParser::keepsPayload(quint8 command, quint8 features)
+{
+    switch (command) {
+    case 0xa1: // IDENTIFY PACKET DEVICE
+    case 0xec: // IDENTIFY DEVICE
+        return true;
+    case 0xb0: // S.M.A.R.T. READ DATA
+        return features == 0xd0;
+    default:
+        return false;
+    }
+}
+
+bool TransactionParser::isExtended(quint8 command)
+{
+    switch (command) {
+    case 0x24: // READ SECTOR(S) EXT
+    case 0x25: // READ DMA EXT
+    case 0x27: // READ NATIVE MAX ADDRESS EXT
+    case 0x29: // READ MULTIPLE EXT
+    case 0x2f: // READ LOG EXT
+    case 0x34: // WRITE SECTOR(S) EXT
+    case 0x35: // WRITE DMA EXT
+    case 0x37: // SET NATIVE MAX ADDRESS EXT
+    case 0x39: // WRITE MULTIPLE EXT
+    case 0x3f: // WRITE LOG EXT
+    case 0x42: // READ VERIFY SECTORS EXT
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool TransactionParser::parseFile(const QString &path,
+                                  const std::function<void(const transaction_t &)> &callback)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    TransactionParser parser;
+    QByteArray buffer(PARSER_READ_SIZE, 0);
+    qint64 index = 0;
+
+    while (true) {
+        const qint64 br = file.read(buffer.data(), buffer.size());
+        if (br < 0) {
+            file.close();
+            return false;
+        }
+        if (br < (qint64)sizeof(sniffer_item_t))
+            break;
+
+        const sniffer_item_t *item = (const sniffer_item_t*)buffer.constData();
+        const int count = br / sizeof(sniffer_item_t);
+
+        for (int i = 0; i < count; i++, index++) {
+            if (parser.feed(item[i], index))
+                callback(parser.transaction());
+        }
+    }
+
+    if (parser.finish())
+        callback(parser.transaction());
+
+    file.close();
+    return true;
+}
@@ -0,0 +1,71 @@
+/****************************************************************************
+**
+** This file is part of the Parallel ATA Sniffer project.
+** Copyright (C) 2025 Alexander E. <aekhv@vk.com>
+** License: GNU GPL v2, see file LICENSE.
+**
+****************************************************************************/
+
+#ifndef TRANSACTIONPARSER_H
+#define TRANSACTIONPARSER_H
+
+#include <QString>
+#include <QByteArray>
+#include <functional>
+#include "SnifferItem.h"
+
+#define PARSER_READ_SIZE        (1048576)
+#define PARSER_PAYLOAD_SIZE     (512) /* Bytes kept for structured decoding */
+
+// One ATA command with its taskfile, data and completion status
+typedef struct {
+    qint64 offset;          // Sample index of COMMAND register write
+    qint64 taskfileOffset;  // Sample index of the first taskfile write
+    quint8 command;
+    quint16 features;       // Previous (HOB) value in the high byte
+    quint16 sectorCount;    // Previous (HOB) value in the high byte
+    quint64 lba;            // 28 or 48 bits depending on the command
+    quint8 device;
+    quint32 dataWords;      // DATA register accesses
+    quint32 bursts;         // Continuous DATA sequences
+    bool dataRead;          // Direction of the first DATA burst
+    quint32 statusPolls;
+    quint8 status;          // Last STATUS or ALT_STATUS value
+    quint8 error;           // Last ERROR register value
+    bool errorRead;
+    quint64 payloadHash;    // FNV-1a of all DATA words
+    QByteArray payload;     // First sector of the data, for IDENTIFY and SMART only
+} transaction_t;
+
+// Incremental parser turning the samples stream into transactions.
+// A transaction is completed by the first taskfile write of the next one.
+class TransactionParser
+{
+public:
+    TransactionParser();
+    void reset();
+    bool feed(const sniffer_item_t &item, qint64 index);
+    bool finish();
+    const transaction_t &transaction() const { return completed; }
+    static bool isExtended(quint8 command);
+    static bool keepsPayload(quint8 command, quint8 features);
+    static bool parseFile(const QString &path,
+                          const std::function<void(const transaction_t &)> &callback);
+
+private:
+    transaction_t current;
+    transaction_t completed;
+    bool active;            // COMMAND register is written
+    bool keepPayload;
+    qint64 lastData;        // Index of the last DATA sample
+    qint64 taskfileStart;
+    quint16 features;
+    quint16 sectorCount;
+    quint16 lbaLow;
+    quint16 lbaMid;
+    quint16 lbaHigh;
+    quint8 device;
+    void beginTransaction(quint8 command, qint64 index);
+};
+
+#endif // TRANSACTIONPARSER_H
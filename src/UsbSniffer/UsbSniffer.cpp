@@ -7,14 +7,24 @@
 ****************************************************************************/
 
 #include "UsbSniffer.h"
-#include <QFile>
+#include "SnifferItem.h"
+#include <QSettings>
+#include <QDateTime>
+#include <chrono>
+#include <algorithm>
 
-UsbSniffer::UsbSniffer(QObject *parent)
+UsbSniffer::UsbSniffer(int index, QObject *parent)
     : QObject(parent),
     ctx(nullptr),
-    handle(nullptr)
+    handle(nullptr),
+    index(index),
+    startedAt(0),
+    stoppedAt(0),
+    profiler({"control", "bulk", "write", "detect"}, {"Short reads", "Empty status polls"}),
+    profiling(false)
 {
-
+    qRegisterMetaType<statistics_t>();
+    resetStatistics();
 }
 
 UsbSniffer::~UsbSniffer()
@@ -26,6 +36,62 @@ UsbSniffer::~UsbSniffer()
         libusb_exit(ctx);
 }
 
+int UsbSniffer::deviceCount()
+{
+    libusb_context *ctx = nullptr;
+    if (libusb_init(&ctx) < 0)
+        return 0;
+
+    int count = 0;
+    libusb_device **dev_list;
+    if (libusb_get_device_list(ctx, &dev_list) >= 0) {
+        count = findDevices(dev_list).count();
+        libusb_free_device_list(dev_list, 1);
+    }
+
+    libusb_exit(ctx);
+    return count;
+}
+
+qint64 UsbSniffer::timestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+QList<libusb_device*> UsbSniffer::findDevices(libusb_device **dev_list)
+{
+    QList<libusb_device*> list;
+
+    struct libusb_device_descriptor dev_desc;
+    for (int i = 0; dev_list[i]; i++) {
+        if (libusb_get_device_descriptor(dev_list[i], &dev_desc) != LIBUSB_SUCCESS)
+            continue;
+        if ((dev_desc.idVendor == CY_FX_USB_VID) && (dev_desc.idProduct == CY_FX_USB_PID))
+            list.append(dev_list[i]);
+    }
+
+    // Devices are sorted by bus and port numbers, so every
+    // device keeps its index while the cabling is the same
+    std::sort(list.begin(), list.end(), [](libusb_device *a, libusb_device *b) {
+        return devicePath(a) < devicePath(b);
+    });
+
+    return list;
+}
+
+QString UsbSniffer::devicePath(libusb_device *dev)
+{
+    quint8 ports[8];
+    const int count = libusb_get_port_numbers(dev, ports, sizeof(ports));
+
+    QString s = QString("%1").arg(libusb_get_bus_number(dev), 3, 10, QChar('0'));
+    for (int i = 0; i < count; i++)
+        s.append(QString(".%1").arg(ports[i], 2, 10, QChar('0')));
+
+    return s;
+}
+
 void UsbSniffer::init()
 {
     // Init library
@@ -55,38 +121,32 @@ void UsbSniffer::init()
         return;
     }
 
-    // Searching for device
-    int n = -1;
-    struct libusb_device_descriptor dev_desc;
-    for (int i = 0; dev_list[i]; i++) {
-        err = libusb_get_device_descriptor(dev_list[i], &dev_desc);
-        if (err != LIBUSB_SUCCESS) {
-            emit message(QString("FAIL on 'libusb_get_device_descriptor'! ( %1 )")
-                             .arg(libusb_error_name(err)));
-            continue;
-        }
-        if ((dev_desc.idVendor == CY_FX_USB_VID) && (dev_desc.idProduct == CY_FX_USB_PID)) {
-            emit message(QString("Sniffer device found: VID_0x%1&PID_0x%2 USB %3.%4 REV %5.%6")
-                             .arg(dev_desc.idVendor, 4, 16, QChar('0'))
-                             .arg(dev_desc.idProduct, 4, 16, QChar('0'))
-                             .arg((dev_desc.bcdUSB & 0x0f00) >> 8)
-                             .arg((dev_desc.bcdUSB & 0x00f0) >> 4)
-                             .arg(dev_desc.bcdDevice >> 8)
-                             .arg(dev_desc.bcdDevice & 0xFF));
-            n = i;
-            break;
-        }
-    }
+    // Searching for device with the given index
+    const QList<libusb_device*> devices = findDevices(dev_list);
 
     // Check if device not found
-    if (n == -1) {
+    if (index >= devices.count()) {
         emit message("Sniffer device not found!");
         libusb_free_device_list(dev_list, 1);
         return;
     }
 
+    libusb_device *dev = devices.at(index);
+    struct libusb_device_descriptor dev_desc;
+    libusb_get_device_descriptor(dev, &dev_desc);
+    path = devicePath(dev);
+
+    emit message(QString("Sniffer device found: VID_0x%1&PID_0x%2 USB %3.%4 REV %5.%6 at %7")
+                     .arg(dev_desc.idVendor, 4, 16, QChar('0'))
+                     .arg(dev_desc.idProduct, 4, 16, QChar('0'))
+                     .arg((dev_desc.bcdUSB & 0x0f00) >> 8)
+                     .arg((dev_desc.bcdUSB & 0x00f0) >> 4)
+                     .arg(dev_desc.bcdDevice >> 8)
+                     .arg(dev_desc.bcdDevice & 0xFF)
+                     .arg(path));
+
     // Opening the device
-    err = libusb_open(dev_list[n], &handle);
+    err = libusb_open(dev, &handle);
     if (err != LIBUSB_SUCCESS) {
         emit message(QString("FAIL on 'libusb_open'! ( %1 )")
                          .arg(libusb_error_name(err)));
@@ -103,24 +163,165 @@ void UsbSniffer::init()
     }
 
     libusb_free_device_list(dev_list, 1);
-    emit unlockInterface();
+    emit initialized();
 }
 
-void UsbSniffer::start(const QString &path, int clkDiv)
+void UsbSniffer::start(const QString &path, int clkDiv, int transferSize, qint64 epoch)
 {
-    QFile file(path);
+    if (!handle) {
+        emit message("Sniffer device is not initialized!");
+        emit unlockInterface();
+        return;
+    }
+
+    // O_DIRECT is opt-in, its synchronous writes may stall the polling on slow disks
+    CaptureWriter writer;
+    const bool direct = QSettings().value("capture/directIo", false).toBool();
 
-    if (!file.open(QFile::WriteOnly)) {
+    if (!writer.open(path, direct)) {
         emit message(QString("File opening error: %1\n%2")
                          .arg(path)
-                         .arg(file.errorString()));
+                         .arg(writer.errorString()));
+        emit unlockInterface();
         return;
     }
 
     emit lockInterface();
     emit message(QString("File opened: %1")
                      .arg(path));
-    emit updateStatistics(0, 0);
+
+    cancel = false;
+    detector.reset();
+    profiler.reset(profiling, profiling);
+    profiler.setThread(index);
+    const QDateTime started = QDateTime::currentDateTime();
+    bool ok = capture(&writer, clkDiv, transferSize, 0);
+
+    if (!writer.close() && ok) {
+        emit message(QString("File writing error: %1\n%2")
+                         .arg(path)
+                         .arg(writer.errorString()));
+        ok = false;
+    }
+
+    detector.finish();
+    if (detector.save(path + ".anomalies"))
+        emit message(QString("Anomalies detected: %1").arg(detector.total()));
+
+    // Capture start and stop moments are stored relative to the common epoch,
+    // so files of several devices can be aligned to each other
+    QSettings meta(path + ".meta", QSettings::IniFormat);
+    meta.setValue("device/index", index);
+    meta.setValue("device/path", this->path);
+    meta.setValue("capture/started", started.toString(Qt::ISODateWithMs));
+    meta.setValue("capture/clkDiv", clkDiv);
+    meta.setValue("capture/transferSize", transferSize);
+    meta.setValue("capture/startOffsetNs", startedAt - epoch);
+    meta.setValue("capture/stopOffsetNs", stoppedAt - epoch);
+    meta.setValue("capture/samples", counters.samples);
+    meta.setValue("capture/errorCount", errorCount);
+
+    if (profiler.isEnabled()) {
+        emit message("Capture profile:");
+        for (const QString &line : profiler.report())
+            emit message(line);
+        if (profiler.saveTrace(path + ".trace.json"))
+            emit message(QString("Trace saved: %1.trace.json").arg(path));
+    }
+
+    if (errorCount > 0)
+        emit message("Sniffer device error detected.");
+    else if (ok)
+        emit message("Completed.");
+
+    emit unlockInterface();
+}
+
+void UsbSniffer::tune(int clkDivMin, int clkDivMax)
+{
+    static const int transferSizes[] = { 16384, DEFAULT_BUFFER_SIZE, 262144 };
+
+    if (!handle) {
+        emit message("Sniffer device is not initialized!");
+        emit unlockInterface();
+        return;
+    }
+
+    emit lockInterface();
+    emit message(QString("Auto-tune started, clock divider %1...%2, keep the bus busy...")
+                     .arg(clkDivMin)
+                     .arg(clkDivMax));
+
+    cancel = false;
+    profiler.reset(false);
+    int bestClkDiv = 0;
+    int bestTransferSize = 0;
+
+    // Smaller divider means faster PIB clock, so the sweep stops at the
+    // first divider which gives clean data with every transfer size
+    for (int clkDiv = clkDivMin; (clkDiv <= clkDivMax) && !cancel && !bestClkDiv; clkDiv++) {
+        bool allClean = true;
+        int fastestTransferSize = 0;
+        double fastestCost = 0;
+
+        for (const int transferSize : transferSizes) {
+
+            if (!capture(nullptr, clkDiv, transferSize, TUNE_STEP_DURATION)) {
+                if (errorCount == 0) {
+                    // USB failure, the reason is already reported
+                    emit unlockInterface();
+                    return;
+                }
+            }
+
+            if (cancel)
+                break;
+
+            // Bus traffic depends on the host activity only, so the transfer
+            // size is rated by the host side cost of receiving the data
+            const double cost = bulkBytes ? (double(bulkTime) / bulkBytes) : 0.0; // ns per byte
+            const double incorrectRate = counters.samples ? (100.0 * counters.incorrect / counters.samples) : 0.0;
+            const bool clean = (errorCount == 0) && (counters.incorrect == 0) && (counters.samples > 0);
+
+            emit message(QString("  clkDiv %1, transfer %2 KiB: %3 ns/KiB, errors %4, incorrect state %5% %6")
+                             .arg(clkDiv, 2)
+                             .arg(transferSize / 1024, 3)
+                             .arg(cost * 1024, 0, 'f', 0)
+                             .arg(errorCount)
+                             .arg(incorrectRate, 0, 'f', 3)
+                             .arg(counters.samples ? (clean ? "OK" : "") : "(no bus traffic)"));
+
+            allClean &= clean;
+            if (clean && (!fastestTransferSize || (cost < fastestCost))) {
+                fastestTransferSize = transferSize;
+                fastestCost = cost;
+            }
+        }
+
+        if (allClean && !cancel) {
+            bestClkDiv = clkDiv;
+            bestTransferSize = fastestTransferSize;
+        }
+    }
+
+    if (cancel) {
+        emit message("Auto-tune cancelled.");
+    } else if (bestClkDiv == 0) {
+        emit message("Auto-tune failed, no error-free setting found.");
+    } else {
+        emit message(QString("Auto-tune completed: clkDiv %1, transfer %2 KiB.")
+                         .arg(bestClkDiv)
+                         .arg(bestTransferSize / 1024));
+        emit tuned(bestClkDiv, bestTransferSize);
+    }
+
+    emit unlockInterface();
+}
+
+bool UsbSniffer::capture(CaptureWriter *writer, int clkDiv, int transferSize, qint64 duration)
+{
+    resetStatistics();
+    publishStatistics(true);
 
     int err;
 
@@ -135,21 +336,22 @@ void UsbSniffer::start(const QString &path, int clkDiv)
                                   DEFAULT_USB_TIMEOUT);
 
     if (err < 0) {
-        file.close();
         emit message(QString("FAIL on 'libusb_control_transfer'0! ( %1 )")
                          .arg(libusb_error_name(err)));
-        emit unlockInterface();
-        return;
+        return false;
     }
 
-    cancel = false;
+    startedAt = timestamp();
+    stoppedAt = startedAt;
+
     status_t status = {0, 0};
     quint32 bytesCommited = 0;
-    QByteArray buffer(DEFAULT_BUFFER_SIZE, 0);
+    QByteArray buffer(transferSize, 0);
 
-    while (!cancel) {
+    while (!cancel && ((duration == 0) || (timer.elapsed() < duration))) {
 
         // Sniffer status
+        const qint64 polled = profiler.begin();
         err = libusb_control_transfer(handle,
                                       LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
                                       CY_FX_VENDOR_REQUEST, // bRequest
@@ -158,35 +360,30 @@ void UsbSniffer::start(const QString &path, int clkDiv)
                                       (uchar*)&status,      // Buffer to send or receive
                                       sizeof(status),       // Buffer length
                                       DEFAULT_USB_TIMEOUT);
+        profiler.end(STAGE_CONTROL, polled);
 
         if (err < 0) {
-            file.close();
             emit message(QString("FAIL on 'libusb_control_transfer'1! ( %1, %2 )")
                              .arg(libusb_error_name(err)).arg(err));
-            emit unlockInterface();
-            return;
+            return false;
         }
 
         if (status.errorCount > 0) {
-            file.close();
-            emit updateStatistics(status.bytesCommited, status.errorCount);
-            emit message("Sniffer device error detected.");
-            emit unlockInterface();
-            return;
+            errorCount = status.errorCount;
+            publishStatistics(true);
+            return false;
         }
 
         // Receive raw data
         if (status.bytesCommited > bytesCommited) {
-            if (!readBulkData(buffer.data(), status.bytesCommited - bytesCommited)) {
-                file.close();
-                emit unlockInterface();
-                return;
-            }
-            file.write(buffer.data(), status.bytesCommited - bytesCommited);
+            if (!receiveData(writer, buffer, status.bytesCommited - bytesCommited))
+                return false;
             bytesCommited = status.bytesCommited;
-            emit updateStatistics(status.bytesCommited, status.errorCount);
+        } else {
+            profiler.count(COUNTER_EMPTY_POLLS);
         }
 
+        publishStatistics();
     }
 
     // Sniffer stop (wValue = 0)
@@ -200,13 +397,13 @@ void UsbSniffer::start(const QString &path, int clkDiv)
                                   DEFAULT_USB_TIMEOUT);
 
     if (err < 0) {
-        file.close();
         emit message(QString("FAIL on 'libusb_control_transfer'2! ( %1 )")
                          .arg(libusb_error_name(err)));
-        emit unlockInterface();
-        return;
+        return false;
     }
 
+    stoppedAt = timestamp();
+
     // Sniffer status
     err = libusb_control_transfer(handle,
                                   LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_INTERFACE,
@@ -218,35 +415,62 @@ void UsbSniffer::start(const QString &path, int clkDiv)
                                   DEFAULT_USB_TIMEOUT);
 
     if (err < 0) {
-        file.close();
         emit message(QString("FAIL on 'libusb_control_transfer'3! ( %1, %2 )")
                          .arg(libusb_error_name(err)).arg(err));
-        emit unlockInterface();
-        return;
+        return false;
     }
 
     if (status.errorCount > 0) {
-        file.close();
-        emit updateStatistics(status.bytesCommited, status.errorCount);
-        emit message("Sniffer device error detected.");
-        emit unlockInterface();
-        return;
+        errorCount = status.errorCount;
+        publishStatistics(true);
+        return false;
     }
 
     // Receive last part of raw data
     if (status.bytesCommited > bytesCommited) {
-        if (!readBulkData(buffer.data(), status.bytesCommited - bytesCommited)) {
-            file.close();
-            emit unlockInterface();
-            return;
+        if (!receiveData(writer, buffer, status.bytesCommited - bytesCommited))
+            return false;
+    }
+
+    publishStatistics(true);
+    return true;
+}
+
+bool UsbSniffer::receiveData(CaptureWriter *writer, QByteArray &buffer, quint32 length)
+{
+    peakPending = qMax(peakPending, length);
+
+    // Data is received by parts not exceeding the transfer size
+    while (length > 0) {
+        const int part = qMin<quint32>(length, buffer.size());
+
+        if (!readBulkData(buffer.data(), part))
+            return false;
+
+        // Protocol checks are done for the recorded data only
+        if (writer) {
+            qint64 t = profiler.begin();
+            const bool written = writer->write(buffer.constData(), part);
+            profiler.end(STAGE_WRITE, t);
+
+            if (!written) {
+                emit message(QString("FAIL on file writing! ( %1 )")
+                                 .arg(writer->errorString()));
+                return false;
+            }
+
+            t = profiler.begin();
+            detector.feed((const sniffer_item_t*)buffer.constData(),
+                          part / sizeof(sniffer_item_t),
+                          counters.samples);
+            profiler.end(STAGE_DETECT, t);
         }
-        file.write(buffer.data(), status.bytesCommited - bytesCommited);
-        emit updateStatistics(status.bytesCommited, status.errorCount);
+
+        countSamples(buffer.constData(), part);
+        length -= part;
     }
 
-    file.close();
-    emit message("Completed.");
-    emit unlockInterface();
+    return true;
 }
 
 bool UsbSniffer::readBulkData(char *data, int length)
@@ -256,12 +480,16 @@ bool UsbSniffer::readBulkData(char *data, int length)
     while (bytesRead < length) {
 
         int br = 0;
+        const qint64 t = profiler.begin();
+        const qint64 started = timestamp();
         int err = libusb_bulk_transfer(handle,
                                        CY_FX_EP_CONSUMER,
                                        (uchar*)data + bytesRead,
                                        length - bytesRead,
                                        &br,
                                        DEFAULT_USB_TIMEOUT);
+        bulkTime += timestamp() - started;
+        profiler.end(STAGE_BULK, t);
 
         if (err < 0) {
             emit message(QString("FAIL on 'libusb_bulk_transfer'! ( %1 )")
@@ -270,13 +498,90 @@ bool UsbSniffer::readBulkData(char *data, int length)
         }
 
         bytesRead += br;
+        bulkBytes += br;
 
-        if (bytesRead < length)
+        if (bytesRead < length) {
+            profiler.count(COUNTER_SHORT_READS);
             emit message(QString("Warning: %1 of %2 bytes received!")
                              .arg(br)
                              .arg(length - bytesRead));
-
+        }
     }
 
     return true;
 }
+
+void UsbSniffer::countSamples(const char *data, int length)
+{
+    const sniffer_item_t *item = (const sniffer_item_t*)data;
+    const int count = length / sizeof(sniffer_item_t);
+
+    for (int i = 0; i < count; i++, item++) {
+        switch (sampleKind(*item)) {
+        case SAMPLE_INCORRECT:
+            counters.incorrect++;
+            break;
+        case SAMPLE_DATA:
+            counters.data++;
+            break;
+        case SAMPLE_STATUS:
+            counters.statusPolls++;
+            break;
+        case SAMPLE_COMMAND:
+            counters.taskfileWrites++;
+            counters.commands++;
+            break;
+        case SAMPLE_TASKFILE:
+            counters.taskfileWrites++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    counters.samples += count;
+}
+
+void UsbSniffer::resetStatistics()
+{
+    counters = {0, 0, 0, 0, 0, 0};
+    lastCounters = counters;
+    errorCount = 0;
+    peakPending = 0;
+    bulkTime = 0;
+    bulkBytes = 0;
+    lastPublished = 0;
+    timer.start();
+}
+
+void UsbSniffer::publishStatistics(bool force)
+{
+    const qint64 now = timer.elapsed();
+    const qint64 interval = now - lastPublished;
+
+    if (!force && (interval < STATISTICS_INTERVAL))
+        return;
+
+    // Rates are calculated for the last interval only
+    const double seconds = qMax<qint64>(interval, 1) / 1000.0;
+    const quint64 samples = counters.samples - lastCounters.samples;
+    const double share = (samples > 0) ? (100.0 / samples) : 0.0;
+
+    statistics_t st;
+    st.samplesCollected = counters.samples;
+    st.errorCount = errorCount;
+    st.samplesPerSecond = samples / seconds;
+    st.bytesPerSecond = samples * sizeof(sniffer_item_t) / seconds;
+    st.dataShare = (counters.data - lastCounters.data) * share;
+    st.statusShare = (counters.statusPolls - lastCounters.statusPolls) * share;
+    st.taskfileShare = (counters.taskfileWrites - lastCounters.taskfileWrites) * share;
+    st.commandsPerSecond = (counters.commands - lastCounters.commands) / seconds;
+    st.bufferFill = 100.0 * peakPending / DEFAULT_BUFFER_SIZE;
+    st.anomalies = detector.total();
+
+    emit updateStatistics(st);
+
+    lastCounters = counters;
+    lastPublished = now;
+    peakPending = 0;
+}
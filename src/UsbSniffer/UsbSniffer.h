@@ -10,7 +10,12 @@
 #define USBSNIFFER_H
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QList>
 #include <libusb.h>
+#include "AnomalyDetector/AnomalyDetector.h"
+#include "Profiler/Profiler.h"
+#include "CaptureWriter/CaptureWriter.h"
 
 #define CY_FX_USB_VID           (0x04B4)
 #define CY_FX_USB_PID           (0x0101)
@@ -18,35 +23,96 @@
 #define CY_FX_VENDOR_REQUEST    (0xFF)
 #define DEFAULT_USB_TIMEOUT     (1000) /* 1000 ms */
 #define DEFAULT_BUFFER_SIZE     (65536)
+#define STATISTICS_INTERVAL     (500) /* 500 ms */
+#define TUNE_STEP_DURATION      (1000) /* 1000 ms per auto-tune step */
+
+// Profiler stages and counters
+enum { STAGE_CONTROL, STAGE_BULK, STAGE_WRITE, STAGE_DETECT };
+enum { COUNTER_SHORT_READS, COUNTER_EMPTY_POLLS };
 
 typedef struct {
     quint32 errorCount;
     quint32 bytesCommited;
 } status_t;
 
+// Per-block counters, updated on the capture thread
+typedef struct {
+    quint64 samples;
+    quint64 data;           // DATA register accesses
+    quint64 statusPolls;    // STATUS and ALT_STATUS reads
+    quint64 taskfileWrites; // Writes to any command block register except DATA
+    quint64 commands;       // Writes to COMMAND register
+    quint64 incorrect;      // Samples with DIOR equal to DIOW
+} counters_t;
+
+// Capture statistics published to GUI every STATISTICS_INTERVAL
+typedef struct {
+    quint64 samplesCollected;
+    quint32 errorCount;
+    double samplesPerSecond;
+    double bytesPerSecond;
+    double dataShare;       // Percents of samples
+    double statusShare;
+    double taskfileShare;
+    double commandsPerSecond;
+    double bufferFill;      // Peak pending data in percents of buffer size
+    quint64 anomalies;
+} statistics_t;
+
+Q_DECLARE_METATYPE(statistics_t)
+
 class UsbSniffer : public QObject
 {
     Q_OBJECT
 public:
-    explicit UsbSniffer(QObject *parent = nullptr);
+    explicit UsbSniffer(int index = 0, QObject *parent = nullptr);
     ~UsbSniffer();
+    static int deviceCount();
+    static qint64 timestamp(); // Monotonic clock, ns
     void init();
+    void setKnownCommands(const QBitArray &commands) { detector.setKnownCommands(commands); }
 
 public slots:
-    void start(const QString &path, int clkDiv);
+    void start(const QString &path, int clkDiv, int transferSize, qint64 epoch);
+    void tune(int clkDivMin, int clkDivMax);
     void stop() { cancel = true; }
+    void setProfiling(bool enabled) { profiling = enabled; }
 
 signals:
     void message(const QString &s);
+    void initialized();
     void lockInterface();
     void unlockInterface();
-    void updateStatistics(quint32 bytesCommited, quint32 errorCount);
+    void updateStatistics(const statistics_t &statistics);
+    void tuned(int clkDiv, int transferSize);
 
 private:
     libusb_context *ctx;
     libusb_device_handle *handle;
+    int index;      // Sniffer index among all the attached ones
+    QString path;   // Bus and port numbers
+    qint64 startedAt;
+    qint64 stoppedAt;
     volatile bool cancel;
+    AnomalyDetector detector;
+    Profiler profiler;
+    volatile bool profiling; // Applied at the next capture start
+    counters_t counters;
+    counters_t lastCounters;
+    quint32 errorCount;
+    quint32 peakPending;
+    qint64 bulkTime;    // Time spent in bulk transfers, ns
+    quint64 bulkBytes;  // Bytes received by bulk transfers
+    QElapsedTimer timer;
+    qint64 lastPublished;
+    static QList<libusb_device*> findDevices(libusb_device **dev_list);
+    static QString devicePath(libusb_device *dev);
+    bool capture(CaptureWriter *writer, int clkDiv, int transferSize, qint64 duration);
+    bool receiveData(CaptureWriter *writer, QByteArray &buffer, quint32 length);
     bool readBulkData(char *data, int length);
+    void countSamples(const char *data, int length);
+    void resetStatistics();
+    void publishStatistics(bool force = false);
 };
 
 #endif // USBSNIFFER_H
@@ -7,11 +7,59 @@
 ****************************************************************************/
 
 #include "MainWindow/MainWindow.h"
+#include "BatchProcessor/BatchProcessor.h"
+#include "AtaCommandCodes/AtaCommandCodes.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QMutex>
+
+// Batch mode runs without GUI: pata-sniffer --batch <dir> [--jobs <n>]
+static int batch(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setOrganizationName("aekhv");
+    app.setApplicationName("pata-sniffer");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Parallel ATA sniffer");
+    parser.addHelpOption();
+    const QCommandLineOption batchOption("batch", "Process all capture files of <dir>.", "dir");
+    const QCommandLineOption jobsOption("jobs", "Number of worker threads.", "n",
+                                        QString::number(QThread::idealThreadCount()));
+    parser.addOption(batchOption);
+    parser.addOption(jobsOption);
+    parser.process(app);
+
+    // Messages come from the worker threads
+    static QMutex mutex;
+    auto print = [](const QString &s) {
+        QMutexLocker locker(&mutex);
+        QTextStream(stdout) << s << "\n";
+    };
+
+    QMap<quint8, QString> codes;
+    if (!AtaCommandCodes::load(ATA_COMMAND_CODES_FILE, &codes))
+        print(QString("File opening error: %1").arg(ATA_COMMAND_CODES_FILE));
+
+    BatchProcessor processor;
+    processor.setJobs(parser.value(jobsOption).toInt());
+    processor.setKnownCommands(AtaCommandCodes::known(codes));
+    QObject::connect(&processor, &BatchProcessor::message, print);
+
+    return processor.run(parser.value(batchOption)) ? 0 : 1;
+}
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; i++) {
+        if (!qstrcmp(argv[i], "--batch") || !qstrncmp(argv[i], "--batch=", 8))
+            return batch(argc, argv);
+    }
+
     QApplication app(argc, argv);
+    app.setOrganizationName("aekhv");
+    app.setApplicationName("pata-sniffer");
     app.setWindowIcon(QIcon(":/icons/app.ico"));
 
     MainWindow w;
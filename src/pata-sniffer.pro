@@ -9,13 +9,34 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    AnomalyDetector/AnomalyDetector.cpp \
+    AtaCommandCodes/AtaCommandCodes.cpp \
+    BatchProcessor/BatchProcessor.cpp \
+    CaptureWriter/CaptureWriter.cpp \
+    CaptureDiff/CaptureDiff.cpp \
+    Profiler/Profiler.cpp \
+    SummaryPyramid/SummaryPyramid.cpp \
+    TimelineWidget/TimelineWidget.cpp \
+    TransactionParser/TransactionParser.cpp \
     UsbSniffer/UsbSniffer.cpp \
     main.cpp \
-    MainWindow/MainWindow.cpp
+    MainWindow/MainWindow.cpp \
+    PayloadDecoder/PayloadDecoder.cpp
 
 HEADERS += \
+    AnomalyDetector/AnomalyDetector.h \
+    AtaCommandCodes/AtaCommandCodes.h \
     AtaRegisters.h \
+    BatchProcessor/BatchProcessor.h \
+    CaptureWriter/CaptureWriter.h \
+    CaptureDiff/CaptureDiff.h \
     MainWindow/MainWindow.h \
+    PayloadDecoder/PayloadDecoder.h \
+    Profiler/Profiler.h \
+    SnifferItem.h \
+    SummaryPyramid/SummaryPyramid.h \
+    TimelineWidget/TimelineWidget.h \
+    TransactionParser/TransactionParser.h \
     UsbSniffer/UsbSniffer.h
 
 FORMS += \